@@ -0,0 +1,60 @@
+// Evoplex <https://evoplex.org>
+
+#include <algorithm>
+#include <cmath>
+
+#include "equilibrium.h"
+
+namespace evoplex {
+
+void EquilibriumDetector::reset(int window, double tolerance)
+{
+    m_window = window > 0 ? window : 0;
+    m_tolerance = tolerance;
+    m_history.clear();
+}
+
+bool EquilibriumDetector::add(const std::vector<double>& values)
+{
+    if (m_window == 0) {
+        return false;
+    }
+
+    if (m_history.empty()) {
+        m_history.resize(values.size());
+    }
+
+    const size_t capacity = 2 * static_cast<size_t>(m_window);
+    for (size_t i = 0; i < values.size(); ++i) {
+        m_history[i].emplace_back(values[i]);
+        if (m_history[i].size() > capacity) {
+            m_history[i].pop_front();
+        }
+    }
+
+    if (m_history.front().size() < capacity) {
+        return false; // not enough generations yet
+    }
+
+    const size_t w = static_cast<size_t>(m_window);
+    for (size_t i = 0; i < m_history.size(); ++i) {
+        const double oldMean = mean(i, 0, w);
+        const double newMean = mean(i, w, capacity);
+        // relative to the mean, but absolute near 0 (eg, a fraction heading to extinction)
+        if (std::fabs(newMean - oldMean) > m_tolerance * std::max(1.0, std::fabs(newMean))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double EquilibriumDetector::mean(size_t i, size_t first, size_t last) const
+{
+    double sum = 0.0;
+    for (size_t k = first; k < last; ++k) {
+        sum += m_history[i][k];
+    }
+    return last > first ? sum / (last - first) : 0.0;
+}
+
+} // evoplex
@@ -0,0 +1,44 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_EQUILIBRIUM_H
+#define FOLLOWFLEE_EQUILIBRIUM_H
+
+#include <deque>
+#include <vector>
+
+namespace evoplex {
+
+/**
+ * An online detector of the statistical equilibrium of a few observables.
+ * It keeps the last 2*window values of each observable and compares the mean
+ * of the older half with the mean of the newer half. The run is considered
+ * stationary when, for all observables, |newer - older| <= tolerance * max(1, |newer|),
+ * ie, the drift is relative to the newer mean, but absolute while it is below 1.
+ */
+class EquilibriumDetector
+{
+public:
+    /**
+     * @brief Clears the history.
+     * @param window the number of generations in each half (0 disables the detector)
+     * @param tolerance the drift accepted between the two halves (relative, or absolute near 0)
+     */
+    void reset(int window, double tolerance);
+
+    /**
+     * @brief Adds the values of the observables of the last generation.
+     * @returns true if all observables are stationary
+     */
+    bool add(const std::vector<double>& values);
+
+private:
+    int m_window = 0;
+    double m_tolerance = 0.0;
+    std::vector<std::deque<double>> m_history; // by observable
+
+    // the mean of the values in [first, last) of the @p i-th observable
+    double mean(size_t i, size_t first, size_t last) const;
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_EQUILIBRIUM_H
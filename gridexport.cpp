@@ -0,0 +1,66 @@
+// Evoplex <https://evoplex.org>
+
+#include "gridexport.h"
+
+namespace evoplex {
+
+// the header and each buffer start at a cache line
+static inline size_t alignedSize(size_t size)
+{
+    return (size + 63) & ~size_t(63);
+}
+
+bool GridExport::open(const QString& name, quint32 numSlots, quint32 width)
+{
+    m_bufferSize = alignedSize(sizeof(Buffer) + numSlots * sizeof(quint16));
+    if (!m_segment.createNamed(name, alignedSize(sizeof(Header)) + 2 * m_bufferSize)) {
+        return false;
+    }
+
+    // the readers wait for the magic, which is written last
+    Header* h = header();
+    h->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    h->version = Version;
+    h->numSlots = numSlots;
+    h->width = width;
+    h->bufferSize = static_cast<quint32>(m_bufferSize);
+    for (quint32 b = 0; b < 2; ++b) {
+        buffer(b)->sequence.store(0, std::memory_order_relaxed);
+        buffer(b)->generation.store(0, std::memory_order_relaxed);
+    }
+    h->front.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = Magic;
+    return true;
+}
+
+GridExport::Buffer* GridExport::buffer(quint32 b) const
+{
+    char* base = static_cast<char*>(m_segment.data()) + alignedSize(sizeof(Header));
+    return reinterpret_cast<Buffer*>(base + b * m_bufferSize);
+}
+
+quint32 GridExport::back() const
+{
+    return 1 - header()->front.load(std::memory_order_relaxed);
+}
+
+quint16* GridExport::beginWrite()
+{
+    Buffer* b = buffer(back());
+    b->sequence.store(b->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // odd before the slots
+    return reinterpret_cast<quint16*>(reinterpret_cast<char*>(b) + sizeof(Buffer));
+}
+
+void GridExport::publish(quint64 generation)
+{
+    const quint32 b = back();
+    buffer(b)->generation.store(generation, std::memory_order_relaxed);
+    buffer(b)->sequence.store(buffer(b)->sequence.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_release);
+    header()->front.store(b, std::memory_order_release);
+}
+
+} // evoplex
@@ -0,0 +1,85 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_GRIDEXPORT_H
+#define FOLLOWFLEE_GRIDEXPORT_H
+
+#include <atomic>
+#include <plugininterface.h>
+
+#include "sharedmemory.h"
+
+namespace evoplex {
+
+/**
+ * A double-buffered copy of the grid in a named shared memory segment, so
+ * external viewers can map it and render it without going through Evoplex.
+ * Each slot holds strategy * 256 + actions (as in the 16-bit population
+ * files) and the slots are indexed by node id.
+ *
+ * The segment is a Header followed by two buffers, each of them a Buffer
+ * and the slots. The writer fills the buffer which is not the front one and
+ * then flips 'front'. Each buffer has its own sequence, which is odd while
+ * the buffer is being written; so, a reader takes a consistent copy with:
+ *
+ *     do {
+ *         b = header->front;  s = buffer(b)->sequence;
+ *         copy the slots of buffer b;
+ *     } while (s is odd || buffer(b)->sequence != s);
+ *
+ * The writer never waits for the readers.
+ */
+class GridExport
+{
+public:
+    static const quint32 Magic = 0x58474646; // "FFGX"
+    static const quint32 Version = 1;
+
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 numSlots;
+        quint32 width;               // the grid's width, if any (0 otherwise)
+        quint32 bufferSize;          // the bytes between the two buffers
+        std::atomic<quint32> front;  // the buffer holding the latest generation
+    };
+
+    struct Buffer {
+        std::atomic<quint64> sequence;
+        std::atomic<quint64> generation;
+    };
+
+    /**
+     * @brief Creates (or reuses) the segment @p name for @p numSlots slots.
+     * @returns false if the segment could not be created
+     */
+    bool open(const QString& name, quint32 numSlots, quint32 width);
+
+    /**
+     * @brief Unmaps the segment.
+     */
+    void close() { m_segment.release(); }
+
+    bool isOpen() const { return m_segment.data() != nullptr; }
+
+    /**
+     * @brief Starts writing the back buffer.
+     * @returns the slots to be filled before publish()
+     */
+    quint16* beginWrite();
+
+    /**
+     * @brief Makes the back buffer the front one.
+     */
+    void publish(quint64 generation);
+
+private:
+    SharedMemory m_segment;
+    size_t m_bufferSize = 0;
+
+    Header* header() const { return static_cast<Header*>(m_segment.data()); }
+    Buffer* buffer(quint32 b) const;
+    quint32 back() const;
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_GRIDEXPORT_H
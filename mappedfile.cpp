@@ -0,0 +1,81 @@
+// Evoplex <https://evoplex.org>
+
+#include <cstring>
+
+#include "mappedfile.h"
+#include "streamrng.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FOLLOWFLEE_HAS_MMAP
+#endif
+
+namespace evoplex {
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const QString& path)
+{
+    close();
+#ifdef FOLLOWFLEE_HAS_MMAP
+    const int fd = ::open(path.toLocal8Bit().constData(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = data;
+    m_size = size;
+    return true;
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef FOLLOWFLEE_HAS_MMAP
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+quint64 MappedFile::contentHash() const
+{
+    quint64 hash = StreamRng::mix(m_size);
+    const char* bytes = data();
+    size_t i = 0;
+    for (; i + sizeof(quint64) <= m_size; i += sizeof(quint64)) {
+        quint64 word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = StreamRng::mix(hash ^ word);
+    }
+    quint64 tail = 0;
+    if (i < m_size) {
+        std::memcpy(&tail, bytes + i, m_size - i);
+    }
+    return StreamRng::mix(hash ^ tail);
+}
+
+} // evoplex
@@ -0,0 +1,50 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_MAPPEDFILE_H
+#define FOLLOWFLEE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <plugininterface.h>
+
+namespace evoplex {
+
+/**
+ * A file mapped read-only in memory. The pages come straight from the page
+ * cache, so all the processes mapping the same file share one physical copy.
+ * It is only available on POSIX systems; elsewhere open() fails.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Maps the whole file at @p path.
+     * @returns false if the file could not be opened or mapped
+     */
+    bool open(const QString& path);
+
+    /**
+     * @brief Unmaps the file.
+     */
+    void close();
+
+    /**
+     * @brief A 64-bit hash of the contents (splitmix64 over 8-byte words).
+     */
+    quint64 contentHash() const;
+
+    const char* data() const { return static_cast<const char*>(m_data); }
+    size_t size() const { return m_size; }
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_MAPPEDFILE_H
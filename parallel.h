@@ -0,0 +1,50 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_PARALLEL_H
+#define FOLLOWFLEE_PARALLEL_H
+
+#include <algorithm>
+#include <vector>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace evoplex {
+
+/**
+ * @brief The number of contiguous chunks used by parallelFor().
+ */
+inline int parallelChunks()
+{
+    return std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+}
+
+/**
+ * @brief Splits [0, n) in @p numChunks contiguous ranges and runs
+ * func(first, last, chunk) for each of them on the global thread pool.
+ * The calling thread blocks (and takes part) until all chunks are done.
+ */
+template<typename Func>
+void parallelFor(size_t n, int numChunks, Func func)
+{
+    struct Chunk { size_t first; size_t last; int index; };
+    std::vector<Chunk> chunks;
+    chunks.reserve(static_cast<size_t>(numChunks));
+    const size_t chunkSize = (n + numChunks - 1) / numChunks;
+    for (int c = 0; c < numChunks; ++c) {
+        const size_t first = std::min(n, c * chunkSize);
+        const size_t last = std::min(n, first + chunkSize);
+        chunks.push_back({first, last, c});
+    }
+
+    if (numChunks == 1) {
+        func(chunks[0].first, chunks[0].last, 0);
+        return;
+    }
+
+    QtConcurrent::blockingMap(chunks, [&func](const Chunk& c) {
+        func(c.first, c.last, c.index);
+    });
+}
+
+} // evoplex
+#endif // FOLLOWFLEE_PARALLEL_H
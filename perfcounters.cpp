@@ -0,0 +1,109 @@
+// Evoplex <https://evoplex.org>
+
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace evoplex {
+
+#ifdef __linux__
+static int openEvent(quint32 type, quint64 config)
+{
+    perf_event_attr pe;
+    std::memset(&pe, 0, sizeof(pe));
+    pe.type = type;
+    pe.size = sizeof(pe);
+    pe.config = config;
+    pe.disabled = 1;
+    // user-space only; it keeps working with perf_event_paranoid=2
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    // the calling thread, on any cpu
+    return static_cast<int>(syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0));
+}
+
+static quint64 cacheConfig(quint64 cache, quint64 op, quint64 result)
+{
+    return cache | (op << 8) | (result << 16);
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+    openAll();
+}
+
+PerfCounters::~PerfCounters()
+{
+    closeAll();
+}
+
+void PerfCounters::openAll()
+{
+    m_fds.fill(-1);
+    m_thread = std::this_thread::get_id();
+#ifdef __linux__
+    m_fds[Cycles] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    m_fds[Instructions] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    m_fds[L1DMisses] = openEvent(PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_L1D,
+            PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    m_fds[LLCMisses] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    m_fds[BranchMisses] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+}
+
+void PerfCounters::closeAll()
+{
+#ifdef __linux__
+    for (int fd : m_fds) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+    m_fds.fill(-1);
+}
+
+bool PerfCounters::isAvailable() const
+{
+    for (int fd : m_fds) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+void PerfCounters::start()
+{
+    if (m_thread != std::this_thread::get_id()) {
+        closeAll();
+        openAll();
+    }
+#ifdef __linux__
+    for (int fd : m_fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void PerfCounters::stop(Readings& readings)
+{
+#ifdef __linux__
+    for (int e = 0; e < NumEvents; ++e) {
+        if (m_fds[e] < 0) continue;
+        ioctl(m_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+        quint64 value = 0;
+        if (read(m_fds[e], &value, sizeof(value)) == sizeof(value)) {
+            readings.values[e] += value;
+        }
+    }
+#endif
+    ++readings.samples;
+}
+
+} // evoplex
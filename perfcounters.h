@@ -0,0 +1,72 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_PERFCOUNTERS_H
+#define FOLLOWFLEE_PERFCOUNTERS_H
+
+#include <array>
+#include <thread>
+#include <plugininterface.h>
+
+namespace evoplex {
+
+/**
+ * A thin wrapper around the Linux perf_event_open() interface.
+ * It counts the hardware events of the calling thread between start() and stop().
+ * When the counters are not available (eg, non-Linux systems, containers or
+ * restrictive perf_event_paranoid settings), all the events are reported as invalid.
+ * The counters follow the thread which calls start(), ie, they are reopened
+ * whenever the model is stepped by a different worker thread.
+ */
+class PerfCounters
+{
+public:
+    enum Event { Cycles, Instructions, L1DMisses, LLCMisses, BranchMisses };
+    static const int NumEvents = 5;
+
+    /**
+     * A convenient struct used to accumulate the readings of a phase.
+     */
+    struct Readings {
+        std::array<quint64, NumEvents> values;
+        quint64 samples = 0; // number of start()/stop() pairs
+        bool partial = false; // the phase also ran on other threads, which were not counted
+
+        Readings() { values.fill(0); }
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Checks if at least one of the events could be opened.
+     */
+    bool isAvailable() const;
+
+    /**
+     * @brief Checks if the @p event could be opened.
+     */
+    bool isAvailable(Event event) const { return m_fds[event] >= 0; }
+
+    /**
+     * @brief Resets and enables the counters for the calling thread.
+     */
+    void start();
+
+    /**
+     * @brief Disables the counters and adds their values to @p readings.
+     */
+    void stop(Readings& readings);
+
+private:
+    std::array<int, NumEvents> m_fds;
+    std::thread::id m_thread;
+
+    void openAll();
+    void closeAll();
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_PERFCOUNTERS_H
@@ -1,174 +1,2081 @@
 // Evoplex <https://evoplex.org>
 
 #include <bitset>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
 
+#ifdef __linux__
+#include <cerrno>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+#include "parallel.h"
 #include "plugin.h"
 
-namespace evoplex {
+namespace evoplex {
+
+static inline int popCount(quint64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    int count = 0;
+    for (; x; x &= x - 1) ++count;
+    return count;
+#endif
+}
+
+// the payoff of the prisoner's dilemma game, or 0 if a cell is empty; it has no
+// branches, so the loops over the replicas can be vectorised
+static inline int gamePayoff(int strA, int strB)
+{
+    const int payoff = strA == 1 ? (strB == 1 ? 3 : 0) : (strB == 1 ? 5 : 1);
+    return (strA != 0 && strB != 0) ? payoff : 0;
+}
+
+// the 0.975 quantile of Student's t distribution with @p df degrees of freedom
+static double studentT975(int df)
+{
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df <= 30) {
+        return table[df - 1];
+    }
+    // the Cornish-Fisher expansion around the normal quantile (error < 1e-4)
+    const double z = 1.959964, z2 = z * z, n = df;
+    return z + z * (z2 + 1) / (4 * n)
+             + z * ((5 * z2 + 16) * z2 + 3) / (96 * n * n)
+             + z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / (384 * n * n * n);
+}
+
+static inline int countTrailingZeros(quint64 x)
+{
+    Q_ASSERT(x != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int count = 0;
+    for (; !(x & 1); x >>= 1) ++count;
+    return count;
+#endif
+}
+
+bool FollowFlee::init()
+{
+    m_repMode = repModeFromString(attr("repMode", "").toString());
+    m_repRate = attr("repRate", -1.0).toDouble();
+    m_stepsPerGen = attr("stepsPerGen", -1).toInt();
+    m_updateScheme = updateSchemeFromString(attr("updateScheme", "randomSequential").toString());
+    m_stepBudget = attr("stepBudget", 0).toInt();
+    m_cellLayout = cellLayoutFromString(attr("cellLayout", "nodeIds").toString());
+    m_adjacencyCache = attr("adjacencyCache", false).toBool();
+    m_population = populationFromString(attr("population", "fromNodes").toString());
+    m_density = attr("density", 0.5).toDouble();
+    m_initialCooperators = attr("initialCooperators", 0.5).toDouble();
+    m_actionBitProbability = attr("actionBitProbability", 0.5).toDouble();
+    m_commonRandomNumbers = attr("commonRandomNumbers", false).toBool();
+
+    m_replicas.replicates = attr("replicas", 0).toInt();
+    m_replicas.first = attr("firstReplica", 0).toInt();
+    m_replicas.replicateSteps = attr("replicateSteps", 0).toInt();
+    m_replicas.maxReplicates = attr("maxReplicates", 0).toInt();
+    m_replicas.ciHalfWidth = attr("ciHalfWidth", 0.0).toDouble();
+    m_replicas.ciOnMeanScore = attr("ciObservable", "cooperatorFraction").toString() == "meanScore";
+    m_ciOutput = attr("ciOutput", "").toString();
+    if (m_replicas.replicates > 0 && m_updateScheme != Synchronous) {
+        qWarning("the replicas are only available with the synchronous update scheme.");
+        return false;
+    }
+    if (m_replicas.replicateSteps > 0 && m_replicas.replicates <= 0) {
+        qWarning("the adaptive replication needs the number of replicas of each point.");
+        return false;
+    }
+    if (m_replicas.replicateSteps > 0 && m_replicas.ciHalfWidth <= 0.0 && m_replicas.maxReplicates <= 0) {
+        qWarning("the adaptive replication needs 'ciHalfWidth' or 'maxReplicates' to stop.");
+        return false;
+    }
+    if (!parseSweep(attr("sweep", "").toString())) {
+        return false;
+    }
+
+    m_forkAt = attr("forkAt", 0).toInt();
+    m_forkSteps = attr("forkSteps", 0).toInt();
+    m_forkOutput = attr("forkOutput", "").toString();
+    if (!parseBranches(attr("forkBranches", "").toString())) {
+        return false;
+    }
+
+    m_initialGrid.clear();
+    if (m_population == FromFile && !loadInitialGrid(attr("populationFile", "").toString())) {
+        return false;
+    }
+    m_memoSteps = attr("memoSteps", false).toBool();
+    m_stopOnCycle = attr("stopOnCycle", true).toBool();
+
+    m_perf.reset();
+    if (attr("perfCounters", false).toBool()) {
+        m_perf.reset(new PerfCounters());
+        if (!m_perf->isAvailable()) {
+            qWarning("hardware performance counters are not available; "
+                     "the perf outputs will be reported as -1.");
+        }
+    }
+
+    return m_repRate > -1 && m_stepsPerGen > -1;
+}
+
+void FollowFlee::beforeLoop()
+{
+    // the only draw from the model's PRG in the common random numbers mode
+    m_crnKey = m_commonRandomNumbers ? static_cast<quint64>(prg()->uniform(INT32_MAX)) : 0;
+    m_generation = 0;
+    m_slice = Slice();
+
+    m_agents.clear();
+    m_emptyCells.clear();
+    m_agents.reserve(nodes().size());
+
+    // the grid's width is needed to lay out the cells in Z-order
+    int width = 0;
+    if (m_cellLayout == Topology::ZOrder) {
+        width = graph()->attr("width", 0).toInt();
+        if (width <= 0) {
+            qWarning("the Z-order layout needs a grid with a 'width'; using the node ids instead.");
+        }
+    }
+    buildTopology(width);
+    m_strategies.assign(m_topology->size(), 0);
+    m_actions.assign(m_topology->size(), 0);
+    m_vacantNeighbours.assign(m_topology->size(), 0);
+    m_memo.clear();
+    if (m_memoSteps) {
+        m_memo.resize(m_topology->size());
+    }
+    m_claims.reset();
+    if (m_updateScheme == Synchronous) {
+        m_claims.reset(new std::atomic<quint64>[m_topology->size()]);
+        for (int id = 0; id < m_topology->size(); ++id) {
+            m_claims[id].store(0, std::memory_order_relaxed);
+        }
+    }
+    m_occupancy.reset();
+    if (m_updateScheme == Asynchronous) {
+        m_occupancy.reset(new std::atomic<quint8>[m_topology->size()]);
+    }
+    m_dirty.clear();
+    m_dirtyStamp = 0;
+    if (m_updateScheme == Speculative) {
+        m_dirty.assign(m_topology->size(), 0);
+    }
+    m_stateHash = 0;
+    m_hashHistory.clear();
+    m_cyclePeriod = 0;
+    m_cycleRun = 0;
+    m_cooperatorFraction = 0.0;
+    m_meanScore = 0.0;
+    m_equilibrium.reset(attr("eqWindow", 0).toInt(), attr("eqTolerance", 0.0).toDouble());
+
+    // the initial population, either read from the nodes or created here
+    if (m_population == FromNodes) {
+        for (Node node : nodes()) {
+            const int strategy = node.attr(Strategy).toInt();
+            if (strategy > 0) {
+                const int cell = cellOf(node);
+                m_strategies[cell] = static_cast<quint8>(strategy);
+                m_actions[cell] = static_cast<quint8>(node.attr(Actions).toInt());
+            }
+        }
+    } else {
+        createPopulation();
+    }
+
+    // Find the non-empty nodes (agents)
+    for (Node node : nodes()) {
+        const int cell = cellOf(node);
+        if (m_strategies[cell] > 0) {
+            m_agents.emplace_back(node);
+            m_stateHash ^= cellKey(cell, m_strategies[cell], m_actions[cell]);
+        } else {
+            m_emptyCells.emplace_hint(m_emptyCells.end(), node.id(), node);
+        }
+    }
+
+    // count the empty cells around each cell
+    for (int id = 0; id < m_topology->size(); ++id) {
+        quint16 vacant = 0;
+        for (int nid : m_topology->outNeighbours(id)) {
+            vacant += m_strategies[nid] == 0;
+        }
+        m_vacantNeighbours[id] = vacant;
+    }
+
+    initReplicas();
+
+    // the grid is published at the end of each generation
+    m_gridExport.close();
+    const QString gridExport = attr("gridExport", "").toString();
+    if (!gridExport.isEmpty()) {
+        if (!m_gridExport.open(gridExport, static_cast<quint32>(m_topology->size()),
+                               static_cast<quint32>(std::max(0, graph()->attr("width", 0).toInt())))) {
+            qWarning("unable to create the shared memory '%s'; the grid will not be exported.",
+                     qPrintable(gridExport));
+        } else {
+            exportGrid();
+        }
+    }
+
+    // the telemetry is updated at the end of each generation
+    m_telemetry.close();
+    const QString telemetry = attr("telemetry", "").toString();
+    if (!telemetry.isEmpty() && !m_telemetry.open(telemetry)) {
+        qWarning("unable to create the shared memory '%s'; the telemetry will not be published.",
+                 qPrintable(telemetry));
+    }
+
+    // the initial grid is the first snapshot
+    m_snapshots.close();
+    const QString snapshotOutput = attr("snapshotOutput", "").toString();
+    if (!snapshotOutput.isEmpty()) {
+        if (!m_snapshots.open(snapshotOutput, static_cast<quint32>(m_topology->size()),
+                              static_cast<quint32>(std::max(0, graph()->attr("width", 0).toInt())),
+                              static_cast<quint32>(attr("snapshotKeyframes", 64).toInt()))) {
+            qWarning("unable to write the snapshots '%s'.", qPrintable(snapshotOutput));
+        } else {
+            writeSnapshot();
+        }
+    }
+}
+
+void FollowFlee::createPopulation()
+{
+    std::vector<Node> all;
+    all.reserve(nodes().size());
+    for (Node node : nodes()) {
+        all.emplace_back(node);
+    }
+
+    // each node gets its own random stream, so the population does not depend on the threads
+    const quint64 populationKey = generationKey(PopulationEvent);
+    parallelFor(all.size(), parallelism(), [&](size_t first, size_t last, int) {
+        for (size_t i = first; i < last; ++i) {
+            Node& node = all[i];
+            const int cell = cellOf(node);
+            quint8 strategy;
+            quint8 actions;
+            initialCell(populationKey, node.id(), m_density, strategy, actions);
+            m_strategies[cell] = strategy;
+            m_actions[cell] = actions;
+            node.setAttr(Strategy, strategy);
+            node.setAttr(Actions, actions);
+            node.setAttr(Score, 0);
+        }
+    });
+}
+
+void FollowFlee::initialCell(quint64 populationKey, int nodeId, double density,
+                             quint8& strategy, quint8& actions) const
+{
+    StreamRng rng(StreamRng::key(populationKey, static_cast<quint64>(nodeId)));
+    if (m_population != FromFile) {
+        sampleCell(rng, density, strategy, actions);
+        return;
+    }
+    strategy = static_cast<quint8>(m_initialGrid[nodeId] >> 8);
+    actions = 0;
+    if (strategy > 0) {
+        // 8-bit grids only have the strategies; so, draw the actions
+        actions = m_initialGridHasActions ? static_cast<quint8>(m_initialGrid[nodeId] & 0xFF)
+                                          : randomActions(rng);
+    }
+}
+
+void FollowFlee::sampleCell(StreamRng& rng, double density, quint8& strategy, quint8& actions) const
+{
+    strategy = 0;
+    actions = 0;
+    if (rng.uniform() < density) {
+        strategy = rng.uniform() < m_initialCooperators ? 1 : 2;
+        actions = randomActions(rng);
+    }
+}
+
+quint8 FollowFlee::randomActions(StreamRng& rng) const
+{
+    if (m_actionBitProbability == 0.5) {
+        return static_cast<quint8>(rng.next() & 0xFF); // uniform over all genomes
+    }
+    quint8 actions = 0;
+    for (int bit = 0; bit < 8; ++bit) {
+        actions |= static_cast<quint8>((rng.uniform() < m_actionBitProbability) << bit);
+    }
+    return actions;
+}
+
+bool FollowFlee::loadInitialGrid(const QString& path)
+{
+    // a binary PGM (P5): the grey levels are the strategies (8 bits) or, with 16 bits,
+    // strategy * 256 + actions; the pixels follow the node ids (row-major in a squareGrid)
+    MappedFile file;
+    if (!file.open(path)) {
+        qWarning("unable to read the population file '%s'.", qPrintable(path));
+        return false;
+    }
+
+    const char* data = file.data();
+    const size_t size = file.size();
+    size_t pos = 0;
+    auto readField = [&](int& value) {
+        while (pos < size && (isspace(static_cast<unsigned char>(data[pos])) || data[pos] == '#')) {
+            if (data[pos] == '#') {
+                while (pos < size && data[pos] != '\n') ++pos;
+            } else {
+                ++pos;
+            }
+        }
+        value = 0;
+        const size_t begin = pos;
+        for (; pos < size && isdigit(static_cast<unsigned char>(data[pos])); ++pos) {
+            value = value * 10 + (data[pos] - '0');
+        }
+        return pos > begin && value >= 0;
+    };
+
+    int width, height, maxValue;
+    if (size < 2 || data[0] != 'P' || data[1] != '5') {
+        qWarning("the population file must be a binary PGM (P5).");
+        return false;
+    }
+    pos = 2;
+    if (!readField(width) || !readField(height) || !readField(maxValue)
+            || maxValue <= 0 || maxValue > 0xFFFF || pos >= size) {
+        qWarning("the header of the population file is invalid.");
+        return false;
+    }
+    ++pos; // a single whitespace before the pixels
+
+    const size_t numPixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    const size_t bytesPerPixel = maxValue > 0xFF ? 2 : 1;
+    if (numPixels != nodes().size() || size - pos < numPixels * bytesPerPixel) {
+        qWarning("the population file does not match the graph (%d x %d pixels, %d nodes).",
+                 width, height, static_cast<int>(nodes().size()));
+        return false;
+    }
+
+    // by node id, as strategy * 256 + actions
+    m_initialGrid.resize(numPixels);
+    m_initialGridHasActions = bytesPerPixel == 2;
+    const unsigned char* pixels = reinterpret_cast<const unsigned char*>(data + pos);
+    for (size_t id = 0; id < numPixels; ++id) {
+        const quint16 value = m_initialGridHasActions
+                ? static_cast<quint16>(pixels[2*id] << 8 | pixels[2*id+1])
+                : static_cast<quint16>(pixels[id] << 8);
+        if ((value >> 8) > 2) {
+            qWarning("the population file has an invalid strategy at the pixel %d.", static_cast<int>(id));
+            return false;
+        }
+        m_initialGrid[id] = value;
+    }
+    return true;
+}
+
+void FollowFlee::buildTopology(int width)
+{
+    // the graph attributes which change the adjacency read from the same source
+    const QString edgesFile = graph()->attr("filePath", "").toString();
+    QString graphAttrs = QString::number(static_cast<qulonglong>(nodes().size()));
+    for (const char* name : {"width", "height", "periodic", "neighbours", "directed"}) {
+        graphAttrs += ";" + graph()->attr(name, "").toQString();
+    }
+
+    // the experiments of this process running on the same graph share the topology;
+    // the edges file (if any) is told apart by its size and time of modification
+    QString key = attr("cellLayout", "nodeIds").toString() + ";" + QString::number(width)
+                + ";" + graphAttrs;
+    if (!edgesFile.isEmpty()) {
+        const QFileInfo info(edgesFile);
+        key += ";" + edgesFile + ";" + QString::number(info.size())
+             + ";" + QString::number(info.lastModified().toMSecsSinceEpoch());
+    }
+
+    m_topology = Topology::shared(key, [&](Topology& topology) {
+        // the graphs read from an edges file can reuse the tables compiled by an earlier run
+        if (!m_adjacencyCache || edgesFile.isEmpty()) {
+            topology.build(nodes(), m_cellLayout, width);
+            return;
+        }
+
+        // the cache is identified by the contents of the edges file and the graph attributes
+        quint64 sourceHash = 0;
+        {
+            MappedFile source;
+            if (!source.open(edgesFile)) {
+                qWarning("unable to read '%s'; the adjacency will not be cached.", qPrintable(edgesFile));
+                topology.build(nodes(), m_cellLayout, width);
+                return;
+            }
+            sourceHash = source.contentHash();
+        }
+        const QByteArray graphBytes = graphAttrs.toLocal8Bit();
+        quint64 graphHash = StreamRng::mix(0);
+        for (char c : graphBytes) {
+            graphHash = StreamRng::mix(graphHash ^ static_cast<quint8>(c));
+        }
+
+        // one cache per layout, next to the edges file
+        const QString cacheFile = edgesFile + "." + attr("cellLayout", "nodeIds").toString() + ".csr";
+        if (topology.load(cacheFile, sourceHash, graphHash, m_cellLayout, width)
+                && static_cast<size_t>(topology.size()) >= nodes().size()) {
+            return;
+        }
+
+        topology.build(nodes(), m_cellLayout, width);
+        if (!topology.save(cacheFile, sourceHash, graphHash, m_cellLayout, width)) {
+            qWarning("unable to write the adjacency cache '%s'.", qPrintable(cacheFile));
+        }
+    });
+}
+
+bool FollowFlee::algorithmStep()
+{
+    // a generation sliced by the time budget continues where the last call stopped
+    if (m_slice.active) {
+        return slicedStep();
+    }
+
+    // the branches continue from the state reached so far
+    if (m_forkAt > 0 && m_generation == m_forkAt && !m_branches.empty()) {
+        forkBranches();
+    }
+    ++m_generation;
+
+    if (m_replicas.size > 0) {
+        resetOutputs();
+        return replicasStep();
+    }
+    if (m_agents.empty()) {
+        resetOutputs();
+        return true; // nothing to do
+    }
+
+    // sort agents by id
+    // it's important to ensure the same initial condition before shuffling
+    // otherwise, the play and step-by-step buttons will lead to different outputs
+    std::sort(m_agents.begin(), m_agents.end(),
+        [](Node i,Node j) { return i.id() <  j.id(); });
+
+    // the random-sequential generations can be spread over several calls;
+    // the outputs keep the values of the last complete generation meanwhile
+    if (m_stepBudget > 0 && m_updateScheme == RandomSequential) {
+        shuffleAgents();
+        m_slice = Slice();
+        m_slice.active = true;
+        return slicedStep();
+    }
+
+    resetOutputs();
+    Counters counters;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (m_perf) m_perf->start();
+
+    if (m_updateScheme == Synchronous) {
+        // the order of the agents does not matter
+        synchronousSteps(counters);
+    } else if (m_updateScheme == Asynchronous) {
+        shuffleAgents();
+        asynchronousSteps(counters);
+    } else if (m_updateScheme == Speculative) {
+        shuffleAgents();
+        speculativeSteps(counters);
+    } else {
+        // shuffle the vector of ids
+        shuffleAgents();
+
+        // A convenient struct to hold the neighbourhood state.
+        // As it's a regular graph, let's create it only once, reserve enough
+        // space and reuse the same object (clear) when necessary.
+        Horizon horizon(graph()->attr("neighbours").toUInt());
+
+        // for each agent in the population
+        for (Node& agent : m_agents) {
+            runAgent(agent, horizon, counters);
+        }
+    }
+
+    if (m_perf) {
+        m_perf->stop(m_stepReadings);
+        // the counters follow this thread only; the chunks run by the pool are not counted
+        m_stepReadings.partial = m_updateScheme != RandomSequential && parallelism() > 1;
+    }
+    m_stepNsecs = timer.nsecsElapsed();
+
+    return endGeneration(counters);
+}
+
+bool FollowFlee::slicedStep()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!m_slice.pendingReplacement) {
+        if (m_perf) m_perf->start();
+        Horizon horizon(graph()->attr("neighbours").toUInt());
+        while (m_slice.cursor < m_agents.size()) {
+            runAgent(m_agents[m_slice.cursor++], horizon, m_slice.counters);
+            if (timer.elapsed() >= m_stepBudget) {
+                break;
+            }
+        }
+        if (m_perf) m_perf->stop(m_slice.stepReadings);
+        m_slice.stepNsecs += timer.nsecsElapsed();
+
+        if (m_slice.cursor < m_agents.size()) {
+            return true; // to be continued
+        }
+        if (timer.elapsed() >= m_stepBudget) {
+            m_slice.pendingReplacement = true;
+            return true; // the replacement goes to the next call
+        }
+    }
+
+    // the generation is complete
+    Counters counters = m_slice.counters;
+    resetOutputs();
+    m_stepReadings = m_slice.stepReadings;
+    m_stepNsecs = m_slice.stepNsecs;
+    m_slice = Slice();
+    return endGeneration(counters);
+}
+
+void FollowFlee::resetOutputs()
+{
+    m_counters = Counters();
+    m_stepReadings = PerfCounters::Readings();
+    m_repReadings = PerfCounters::Readings();
+    m_agentSteps = 0;
+    m_stepNsecs = 0;
+    m_replacementNsecs = 0;
+}
+
+void FollowFlee::exportGrid()
+{
+    if (!m_gridExport.isOpen()) {
+        return;
+    }
+
+    gridByNodeId(m_gridExport.beginWrite());
+    m_gridExport.publish(static_cast<quint64>(m_generation));
+}
+
+void FollowFlee::writeSnapshot()
+{
+    if (!m_snapshots.isOpen()) {
+        return;
+    }
+    m_snapshotGrid.resize(static_cast<size_t>(m_topology->size()));
+    gridByNodeId(m_snapshotGrid.data());
+    m_snapshots.write(static_cast<quint64>(m_generation), m_snapshotGrid.data());
+}
+
+void FollowFlee::gridByNodeId(quint16* grid) const
+{
+    const bool batch = m_replicas.size > 0;
+    const size_t stride = batch ? static_cast<size_t>(m_replicas.size) : 1;
+    const quint8* strategies = batch ? m_replicas.strategies.data() : m_strategies.data();
+    const quint8* actions = batch ? m_replicas.actions.data() : m_actions.data();
+    parallelFor(static_cast<size_t>(m_topology->size()), parallelism(), [&](size_t first, size_t last, int) {
+        for (size_t cell = first; cell < last; ++cell) {
+            grid[m_topology->nodeId(static_cast<int>(cell))] = static_cast<quint16>(
+                (strategies[cell * stride] << 8) | actions[cell * stride]);
+        }
+    });
+}
+
+void FollowFlee::publishTelemetry(quint64 agents, quint64 emptyCells)
+{
+    if (!m_telemetry.isOpen()) {
+        return;
+    }
+
+    Telemetry::Record sample;
+    sample.generation = static_cast<quint64>(m_generation);
+    sample.agentSteps = m_agentSteps;
+    sample.stepSeconds = m_stepNsecs * 1e-9;
+    sample.replacementSeconds = m_replacementNsecs * 1e-9;
+    sample.agentStepsPerSecond = m_stepNsecs > 0 ? m_agentSteps / sample.stepSeconds : 0.0;
+    sample.agents = agents;
+    sample.emptyCells = emptyCells;
+    m_telemetry.publish(sample);
+}
+
+bool FollowFlee::endGeneration(Counters& counters)
+{
+    m_agentSteps = m_agents.size() * static_cast<quint64>(m_stepsPerGen);
+
+    qint64 totalScore = 0;
+    for (const Node& agent : m_agents) {
+        totalScore += agent.attr(Score).toInt();
+    }
+    m_meanScore = static_cast<double>(totalScore) / m_agents.size();
+
+    // replacement phase; prepares the next generation
+    auto agentsToReplace = static_cast<quint32>(floor(m_agents.size() * m_repRate));
+    if (agentsToReplace > 0) {
+        QElapsedTimer timer;
+        timer.start();
+        if (m_perf) m_perf->start();
+        if (m_repMode == SimpleBD) {
+            simpleBD(agentsToReplace);
+        } else if (m_repMode == NeighbourBD) {
+            neighbourBD(agentsToReplace, counters);
+        } else {
+            qFatal("the replacement mode is invalid!");
+        }
+        if (m_perf) m_perf->stop(m_repReadings);
+        m_replacementNsecs = timer.nsecsElapsed();
+    }
+
+    m_counters.merge(counters);
+
+    size_t cooperators = 0;
+    for (const Node& agent : m_agents) {
+        cooperators += m_strategies[cellOf(agent)] == 1;
+    }
+    m_cooperatorFraction = static_cast<double>(cooperators) / m_agents.size();
+
+    exportGrid();
+    writeSnapshot();
+    publishTelemetry(m_agents.size(), m_emptyCells.size());
+
+    if (detectCycle() && m_stopOnCycle) {
+        return false; // the configuration stopped changing
+    }
+
+    if (m_equilibrium.add({m_cooperatorFraction, m_meanScore})) {
+        return false; // the observables are stationary
+    }
+
+    return true;
+}
+
+void FollowFlee::afterLoop()
+{
+#ifdef __linux__
+    for (qint64 pid : m_branchPids) {
+        int status = 0;
+        pid_t reaped;
+        do {
+            reaped = waitpid(static_cast<pid_t>(pid), &status, 0);
+        } while (reaped < 0 && errno == EINTR);
+        if (reaped < 0) {
+            status = -1;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            qWarning("the branch process %lld has failed.", static_cast<long long>(pid));
+        }
+    }
+#endif
+    m_branchPids.clear();
+    m_snapshots.close(); // writes the index
+}
+
+Values FollowFlee::customOutputs(const Values& inputs) const
+{
+    Values outputs;
+    outputs.reserve(inputs.size());
+    for (const Value& input : inputs) {
+        const QString name = input.toQString();
+        if (name == "moves") {
+            outputs.emplace_back(static_cast<int>(m_counters.moves));
+        } else if (name == "blocked") {
+            outputs.emplace_back(static_cast<int>(m_counters.blocked));
+        } else if (name == "randomMoves") {
+            outputs.emplace_back(static_cast<int>(m_counters.randomMoves));
+        } else if (name == "uniqueMax") {
+            outputs.emplace_back(static_cast<int>(m_counters.uniqueMax));
+        } else if (name == "ties") {
+            outputs.emplace_back(static_cast<int>(m_counters.ties));
+        } else if (name == "randomActions") {
+            outputs.emplace_back(static_cast<int>(m_counters.randomActions));
+        } else if (name == "fallbacks") {
+            outputs.emplace_back(static_cast<int>(m_counters.fallbacks));
+        } else if (name == "replays") {
+            outputs.emplace_back(static_cast<int>(m_counters.replays));
+        } else if (name == "conflicts") {
+            outputs.emplace_back(static_cast<int>(m_counters.conflicts));
+        } else if (name == "cooperatorFraction") {
+            outputs.emplace_back(m_cooperatorFraction);
+        } else if (name == "meanScore") {
+            outputs.emplace_back(m_meanScore);
+        } else if (name == "cooperatorFractionStdDev") {
+            outputs.emplace_back(m_cooperatorFractionStdDev);
+        } else if (name == "meanScoreStdDev") {
+            outputs.emplace_back(m_meanScoreStdDev);
+        } else if (name == "pendingPoints") {
+            outputs.emplace_back(m_pendingPoints);
+        } else if (name == "cyclePeriod") {
+            outputs.emplace_back(m_cyclePeriod);
+        } else if (name == "memoHits") {
+            outputs.emplace_back(static_cast<int>(m_counters.memoHits));
+        } else if (name == "memoHitRate") {
+            const quint64 total = m_counters.memoHits + m_counters.memoMisses;
+            outputs.emplace_back(total ? static_cast<double>(m_counters.memoHits) / total : 0.0);
+        } else if (name == "cyclesPerStep") {
+            outputs.emplace_back(perfOutput(m_stepReadings, PerfCounters::Cycles, m_agentSteps));
+        } else if (name == "instructionsPerStep") {
+            outputs.emplace_back(perfOutput(m_stepReadings, PerfCounters::Instructions, m_agentSteps));
+        } else if (name == "l1dMissesPerStep") {
+            outputs.emplace_back(perfOutput(m_stepReadings, PerfCounters::L1DMisses, m_agentSteps));
+        } else if (name == "llcMissesPerStep") {
+            outputs.emplace_back(perfOutput(m_stepReadings, PerfCounters::LLCMisses, m_agentSteps));
+        } else if (name == "branchMissesPerStep") {
+            outputs.emplace_back(perfOutput(m_stepReadings, PerfCounters::BranchMisses, m_agentSteps));
+        } else if (name == "replacementCycles") {
+            outputs.emplace_back(perfOutput(m_repReadings, PerfCounters::Cycles, 1));
+        } else if (name == "replacementInstructions") {
+            outputs.emplace_back(perfOutput(m_repReadings, PerfCounters::Instructions, 1));
+        } else if (name == "replacementL1dMisses") {
+            outputs.emplace_back(perfOutput(m_repReadings, PerfCounters::L1DMisses, 1));
+        } else if (name == "replacementLlcMisses") {
+            outputs.emplace_back(perfOutput(m_repReadings, PerfCounters::LLCMisses, 1));
+        } else if (name == "replacementBranchMisses") {
+            outputs.emplace_back(perfOutput(m_repReadings, PerfCounters::BranchMisses, 1));
+        } else {
+            outputs.emplace_back(Value());
+        }
+    }
+    return outputs;
+}
+
+Value FollowFlee::perfOutput(const PerfCounters::Readings& readings,
+                             PerfCounters::Event event, quint64 divisor) const
+{
+    if (!m_perf || !m_perf->isAvailable(event) || readings.samples == 0 || readings.partial
+            || divisor == 0) {
+        return Value(-1.0);
+    }
+    return Value(static_cast<double>(readings.values[event]) / divisor);
+}
+
+void FollowFlee::runAgent(Node& agent, Horizon& horizon, Counters& counters)
+{
+    // reset score
+    agent.setAttr(Score, 0);
+
+    // Fully surrounded agents cannot move and, as only this agent moves
+    // during its own steps, the neighbourhood stays the same in all of them.
+    const int cell = cellOf(agent);
+    if (m_vacantNeighbours[cell] == 0) {
+        agent.setAttr(Score, payoff(cell) * m_stepsPerGen);
+        counters.blocked += static_cast<quint64>(m_stepsPerGen);
+        return;
+    }
+
+    // the agent takes s steps per generation
+    EventRng rng = eventRng(MoveEvent, agent.id());
+    for (int step = 0; step < m_stepsPerGen; ++step) {
+        if (m_memoSteps) {
+            memoisedStep(agent, horizon, rng, counters);
+        } else {
+            updateScoreAndHorizon(agent, horizon);
+            updatePosition(agent, horizon, rng, counters);
+        }
+    }
+}
+
+void FollowFlee::updateScoreAndHorizon(Node& agent, Horizon& horizon) const
+{
+    // update the agent's score
+    agent.setAttr(Score, agent.attr(Score).toInt() + fillHorizon(cellOf(agent), horizon, m_strategies));
+}
+
+template<typename Strategies>
+int FollowFlee::fillHorizon(int id, Horizon& horizon, const Strategies& strategies) const
+{
+    horizon.clear();
+
+    // the agent can stay still; so, it's a free cell too!
+    // important: the center cell is always the first!
+    horizon.freeCells.push_back({id, 0});
+
+    const int strA = strategies[id];
+    int score = 0;
+    for (int nid : m_topology->outNeighbours(id)) {
+        const int strB = strategies[nid];
+
+        // this cell is empty
+        if (strB == 0) {
+            horizon.freeCells.push_back({nid, 0});
+            continue;
+        }
+
+        // accumulate the score received by playing the
+        // prisoner's dilemma game with all neighbours
+        score += playGame(strA, strB);
+
+        // keep track of the neighbourhood state
+        if (strB == 1) {
+            horizon.cooperators.emplace_back(nid);
+        } else {
+            horizon.defectors.emplace_back(nid);
+        }
+    }
+    return score;
+}
+
+void FollowFlee::synchronousSteps(Counters& counters)
+{
+    const size_t numAgents = m_agents.size();
+    const int numChunks = parallelism();
+    const quint32 horizonSize = graph()->attr("neighbours").toUInt();
+
+    // one draw from the model's PRG per generation; every agent-step then
+    // gets its own stream, so the outcome does not depend on the threads
+    const quint64 genKey = generationKey(MoveEvent);
+
+    // the agents' state, by position in m_agents
+    std::vector<int> origins(numAgents);
+    std::vector<int> cells(numAgents);
+    std::vector<int> targets(numAgents);
+    std::vector<quint64> claims(numAgents);
+    std::vector<int> scores(numAgents, 0);
+    std::vector<quint64> streams(numAgents);
+    for (size_t i = 0; i < numAgents; ++i) {
+        origins[i] = cells[i] = cellOf(m_agents[i]);
+        streams[i] = m_commonRandomNumbers ? static_cast<quint64>(m_agents[i].id()) : i;
+    }
+
+    SyncBuffers buffers;
+    buffers.strategies = m_strategies.data();
+    buffers.actions = m_actions.data();
+    buffers.claims = m_claims.get();
+    buffers.streams = streams.data();
+    buffers.cells = cells.data();
+    buffers.targets = targets.data();
+    buffers.claimKeys = claims.data();
+    buffers.scores = scores.data();
+
+    std::vector<Counters> chunkCounters(static_cast<size_t>(numChunks));
+    for (int step = 0; step < m_stepsPerGen; ++step) {
+        // decide: read-only pass over the grid; the moves claim their target cells
+        parallelFor(numAgents, numChunks, [&](size_t first, size_t last, int chunk) {
+            Horizon horizon(horizonSize);
+            for (size_t i = first; i < last; ++i) {
+                decideSynchronous(buffers, i, genKey, step, horizon, chunkCounters[chunk]);
+            }
+        });
+
+        // commit: the winners move; the target and origin cells of the winners are all distinct
+        parallelFor(numAgents, numChunks, [&](size_t first, size_t last, int chunk) {
+            for (size_t i = first; i < last; ++i) {
+                commitSynchronous(buffers, i, chunkCounters[chunk]);
+            }
+        });
+    }
+
+    writeBack(origins, cells, scores, numChunks);
+    for (const Counters& c : chunkCounters) {
+        counters.merge(c);
+    }
+}
+
+void FollowFlee::decideSynchronous(const SyncBuffers& b, size_t i, quint64 genKey, int step,
+                                   Horizon& horizon, Counters& counters) const
+{
+    StreamRng rng(StreamRng::key(genKey, static_cast<quint64>(step), b.streams[i]));
+    const quint8* strategies = b.strategies;
+    b.scores[i] += fillHorizon(b.cells[i], horizon, strategies);
+    b.targets[i] = chooseTarget(b.cells[i], b.actions[b.cells[i]], horizon, rng, counters);
+    if (b.targets[i] == b.cells[i]) {
+        return;
+    }
+    // random priority (high bits) and the agent (low bits); the highest claim wins
+    b.claimKeys[i] = (rng.next() & 0xFFFFFFFF00000000ULL) | static_cast<quint64>(i + 1);
+    std::atomic<quint64>& cell = b.claims[b.targets[i]];
+    quint64 current = cell.load(std::memory_order_relaxed);
+    while (current < b.claimKeys[i] &&
+           !cell.compare_exchange_weak(current, b.claimKeys[i], std::memory_order_relaxed)) {}
+}
+
+void FollowFlee::commitSynchronous(const SyncBuffers& b, size_t i, Counters& counters) const
+{
+    const int cell = b.cells[i];
+    const int target = b.targets[i];
+    if (target == cell) {
+        return;
+    }
+    std::atomic<quint64>& claim = b.claims[target];
+    if (claim.load(std::memory_order_relaxed) != b.claimKeys[i]) {
+        ++counters.conflicts;
+        return;
+    }
+    claim.store(0, std::memory_order_relaxed);
+    b.strategies[target] = b.strategies[cell];
+    b.actions[target] = b.actions[cell];
+    b.strategies[cell] = 0;
+    b.actions[cell] = 0;
+    b.cells[i] = target;
+    ++counters.moves;
+}
+
+bool FollowFlee::parseSweep(const QString& sweep)
+{
+    ReplicaBatch& batch = m_replicas;
+    batch.pointParams.assign(1, {m_repMode, m_repRate, m_stepsPerGen, m_density});
+
+    // the cartesian product of the values, one attribute at a time
+    for (const QString& entry : sweep.split(';', QString::SkipEmptyParts)) {
+        const QStringList nameValues = entry.split('=');
+        const QStringList values = nameValues.size() == 2
+                ? nameValues.at(1).split(',', QString::SkipEmptyParts) : QStringList();
+        const QString name = nameValues.at(0).trimmed();
+        if (values.isEmpty() || (name != "repMode" && name != "repRate"
+                && name != "stepsPerGen" && name != "density")) {
+            qWarning("the sweep entry '%s' is invalid.", qPrintable(entry));
+            return false;
+        }
+        if (name == "density" && m_population != RandomPopulation) {
+            qWarning("a sweep of 'density' needs 'population=random'.");
+            return false;
+        }
+
+        std::vector<ReplicaBatch::Params> points;
+        for (const ReplicaBatch::Params& point : batch.pointParams) {
+            for (const QString& value : values) {
+                ReplicaBatch::Params p = point;
+                bool ok = true;
+                if (name == "repMode") {
+                    p.repMode = repModeFromString(value.trimmed(), &ok);
+                } else if (name == "repRate") {
+                    p.repRate = value.toDouble(&ok);
+                    ok = ok && p.repRate >= 0.05 && p.repRate <= 0.35;
+                } else if (name == "stepsPerGen") {
+                    p.stepsPerGen = value.toInt(&ok);
+                    ok = ok && p.stepsPerGen >= 5 && p.stepsPerGen <= 35;
+                } else {
+                    p.density = value.toDouble(&ok);
+                    ok = ok && p.density >= 0.0 && p.density <= 1.0;
+                }
+                if (!ok) {
+                    qWarning("the sweep value '%s' of '%s' is invalid.", qPrintable(value), qPrintable(name));
+                    return false;
+                }
+                points.emplace_back(p);
+            }
+        }
+        batch.pointParams.swap(points);
+    }
+
+    if (batch.pointParams.size() > 1 && batch.replicates <= 0) {
+        qWarning("a sweep needs the number of replicas of each point.");
+        return false;
+    }
+
+    // replica k runs the point k / replicates (see initReplicas())
+    batch.size = static_cast<int>(batch.pointParams.size()) * std::max(0, batch.replicates);
+    return true;
+}
+
+bool FollowFlee::parseBranches(const QString& branches)
+{
+    m_branches.clear();
+    for (const QString& entry : branches.split('|', QString::SkipEmptyParts)) {
+        Branch branch{m_repMode, m_repRate, m_stepsPerGen};
+        for (const QString& nameValue : entry.split(',', QString::SkipEmptyParts)) {
+            const QStringList parts = nameValue.split('=');
+            const QString name = parts.at(0).trimmed();
+            const QString value = parts.size() == 2 ? parts.at(1).trimmed() : QString();
+            bool ok = !value.isEmpty();
+            if (ok && name == "repMode") {
+                branch.repMode = repModeFromString(value, &ok);
+            } else if (ok && name == "repRate") {
+                branch.repRate = value.toDouble(&ok);
+                ok = ok && branch.repRate >= 0.05 && branch.repRate <= 0.35;
+            } else if (ok && name == "stepsPerGen") {
+                branch.stepsPerGen = value.toInt(&ok);
+                ok = ok && branch.stepsPerGen >= 5 && branch.stepsPerGen <= 35;
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                qWarning("the branch attribute '%s' is invalid.", qPrintable(nameValue));
+                return false;
+            }
+        }
+        m_branches.emplace_back(branch);
+    }
+
+    if (!m_branches.empty() && (m_forkAt <= 0 || m_forkSteps <= 0)) {
+        qWarning("the branches need 'forkAt' and 'forkSteps'.");
+        return false;
+    }
+    return true;
+}
+
+void FollowFlee::forkBranches()
+{
+#ifdef __linux__
+    // the children must not write the parent's buffered frames again
+    m_snapshots.flush();
+    for (size_t b = 0; b < m_branches.size(); ++b) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            _exit(runBranch(b) ? 0 : 1);
+        } else if (pid < 0) {
+            qWarning("unable to fork the branch %d.", static_cast<int>(b));
+        } else {
+            m_branchPids.emplace_back(pid);
+        }
+    }
+#else
+    qWarning("the branches are only available on Linux.");
+#endif
+}
+
+bool FollowFlee::runBranch(size_t branch)
+{
+    // only this thread survives fork() and the pool may be left locked by the
+    // others; so, the branch runs every parallelFor() inline, without the pool
+    m_inBranch = true;
+    const Branch attrs = m_branches[branch];
+    m_branches.clear();
+    m_sweepOutput.reset();
+    m_ciOutput.clear();
+    m_perf.reset();
+    m_gridExport.close();    // the parent keeps publishing its own grid
+    m_telemetry.close();     // and its own telemetry
+    m_snapshots.detach();    // and its own snapshots
+    m_stepBudget = 0;        // a call is a whole generation here
+
+    m_repMode = attrs.repMode;
+    m_repRate = attrs.repRate;
+    m_stepsPerGen = attrs.stepsPerGen;
+    for (std::vector<ReplicaBatch::Params>* params : {&m_replicas.params, &m_replicas.pointParams}) {
+        for (ReplicaBatch::Params& p : *params) {
+            p.repMode = attrs.repMode;
+            p.repRate = attrs.repRate;
+            p.stepsPerGen = attrs.stepsPerGen;
+        }
+    }
+
+    // the random numbers of each branch are keyed by the branch
+    const quint64 branchKey = StreamRng::key(static_cast<quint64>(prg()->seed()),
+                                             static_cast<quint64>(m_forkAt), branch + 1);
+    m_branchPrg.reset(new PRG(static_cast<unsigned>(branchKey)));
+    m_crnKey = StreamRng::key(m_crnKey, branchKey);
+    for (size_t r = 0; r < m_replicas.prgs.size(); ++r) {
+        if (!m_replicas.prgs[r]) {
+            continue;
+        }
+        // as the branch of the single run replayed by the replica
+        const quint64 replicaKey = StreamRng::key(static_cast<quint64>(replicaSeed(r)),
+                                                  static_cast<quint64>(m_forkAt), branch + 1);
+        m_replicas.prgs[r].reset(new PRG(static_cast<unsigned>(replicaKey)));
+        m_replicas.crnKeys[r] = StreamRng::key(m_replicas.crnKeys[r], replicaKey);
+    }
+
+    const QString path = m_forkOutput + "." + QString::number(static_cast<int>(branch)) + ".csv";
+    QFile output(path);
+    if (m_forkOutput.isEmpty() || !output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("unable to write the branch output '%s'.", qPrintable(path));
+        return false;
+    }
+    output.write("step,cooperatorFraction,meanScore,cooperatorFractionStdDev,meanScoreStdDev\n");
+
+    for (int step = 1; step <= m_forkSteps; ++step) {
+        const bool running = algorithmStep();
+        output.write(QByteArray::number(m_forkAt + step) + ','
+                     + QByteArray::number(m_cooperatorFraction) + ','
+                     + QByteArray::number(m_meanScore) + ','
+                     + QByteArray::number(m_cooperatorFractionStdDev) + ','
+                     + QByteArray::number(m_meanScoreStdDev) + '\n');
+        if (!running) {
+            break;
+        }
+    }
+    return output.flush();
+}
+
+int FollowFlee::parallelism() const
+{
+    return m_inBranch ? 1 : parallelChunks();
+}
+
+void FollowFlee::startReplica(size_t replica, int point)
+{
+    ReplicaBatch& batch = m_replicas;
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+    batch.points[replica] = point;
+    if (point >= 0) {
+        batch.params[replica] = batch.pointParams[point];
+        batch.ids[replica] = static_cast<quint64>(batch.first + batch.estimates[point].launched++);
+    }
+
+    // the same draws as in beforeLoop() and createPopulation(), from the replica's own PRG
+    quint64 populationKey = 0;
+    batch.prgs[replica].reset();
+    batch.crnKeys[replica] = 0;
+    if (point >= 0) {
+        batch.prgs[replica].reset(new PRG(replicaSeed(replica)));
+        PRG* prg = batch.prgs[replica].get();
+        if (m_commonRandomNumbers) {
+            batch.crnKeys[replica] = static_cast<quint64>(prg->uniform(INT32_MAX));
+        }
+        if (m_population != FromNodes) {
+            populationKey = generationKey(prg, batch.crnKeys[replica], 0, PopulationEvent);
+        }
+    }
+
+    // the replicas start from the same population, except for the created
+    // ones (random or from a file), which are drawn for each replica
+    parallelFor(batch.cells.size(), parallelism(), [&](size_t first, size_t last, int) {
+        for (size_t k = first; k < last; ++k) {
+            const int cell = batch.cells[k];
+            quint8 strategy = 0;
+            quint8 actions = 0;
+            if (point >= 0 && m_population == FromNodes) {
+                strategy = m_strategies[cell];
+                actions = m_actions[cell];
+            } else if (point >= 0) {
+                initialCell(populationKey, m_topology->nodeId(cell), batch.params[replica].density,
+                            strategy, actions);
+            }
+            batch.strategies[cell * numReplicas + replica] = strategy;
+            batch.actions[cell * numReplicas + replica] = actions;
+            batch.scores[cell * numReplicas + replica] = 0;
+        }
+    });
+}
+
+bool FollowFlee::finishReplicates()
+{
+    ReplicaBatch& batch = m_replicas;
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+
+    for (size_t r = 0; r < numReplicas; ++r) {
+        if (batch.points[r] < 0) {
+            continue;
+        }
+        ReplicaBatch::Estimate& e = batch.estimates[batch.points[r]];
+        const double x = batch.ciOnMeanScore ? batch.meanScores[r] : batch.cooperatorFractions[r];
+        ++e.n;
+        e.sum += x;
+        e.sumSq += x * x;
+    }
+
+    // a point is done once its interval is narrow enough or it runs out of replicates
+    auto halfWidth = [](const ReplicaBatch::Estimate& e) {
+        if (e.n < 2) {
+            return std::numeric_limits<double>::infinity();
+        }
+        const double mean = e.sum / e.n;
+        const double variance = std::max(0.0, (e.sumSq - e.n * mean * mean) / (e.n - 1));
+        return studentT975(e.n - 1) * std::sqrt(variance / e.n);
+    };
+    std::vector<int> pending;
+    std::vector<double> halfWidths(batch.estimates.size());
+    for (size_t p = 0; p < batch.estimates.size(); ++p) {
+        ReplicaBatch::Estimate& e = batch.estimates[p];
+        halfWidths[p] = halfWidth(e);
+        e.done = e.n >= batch.replicates && (halfWidths[p] <= batch.ciHalfWidth
+                 || (batch.maxReplicates > 0 && e.n >= batch.maxReplicates));
+        if (!e.done) {
+            pending.emplace_back(static_cast<int>(p));
+        }
+    }
+    m_pendingPoints = static_cast<int>(pending.size());
+    writeEstimates();
+    if (pending.empty()) {
+        return false;
+    }
+
+    // the replicas are dealt to the pending points in turns, the widest intervals first
+    std::stable_sort(pending.begin(), pending.end(),
+        [&](int a, int b) { return halfWidths[a] > halfWidths[b]; });
+    size_t turn = 0;
+    for (size_t r = 0; r < numReplicas; ++r) {
+        int point = -1;
+        for (size_t tries = 0; tries < pending.size() && point < 0; ++tries) {
+            const int p = pending[turn++ % pending.size()];
+            if (batch.maxReplicates <= 0 || batch.estimates[p].launched < batch.maxReplicates) {
+                point = p;
+            }
+        }
+        startReplica(r, point);
+    }
+    batch.generation = 0;
+    writeFirstReplica();
+    return true;
+}
+
+void FollowFlee::writeEstimates() const
+{
+    if (m_ciOutput.isEmpty()) {
+        return;
+    }
+
+    const ReplicaBatch& batch = m_replicas;
+    QByteArray rows("point,repMode,repRate,stepsPerGen,density,replicates,mean,stdDev,done\n");
+    for (size_t p = 0; p < batch.estimates.size(); ++p) {
+        const ReplicaBatch::Params& params = batch.pointParams[p];
+        const ReplicaBatch::Estimate& e = batch.estimates[p];
+        const double mean = e.n > 0 ? e.sum / e.n : 0.0;
+        const double stdDev = e.n > 1 ? std::sqrt(std::max(0.0, (e.sumSq - e.n * mean * mean) / (e.n - 1))) : 0.0;
+        rows += QByteArray::number(static_cast<qulonglong>(p)) + ','
+              + (params.repMode == SimpleBD ? "simpleBD" : "neighbourBD") + ','
+              + QByteArray::number(params.repRate) + ',' + QByteArray::number(params.stepsPerGen) + ','
+              + QByteArray::number(params.density) + ','
+              + QByteArray::number(e.n) + ',' + QByteArray::number(mean) + ','
+              + QByteArray::number(stdDev) + ',' + (e.done ? "1" : "0") + '\n';
+    }
+
+    QSaveFile file(m_ciOutput);
+    if (!file.open(QIODevice::WriteOnly) || file.write(rows) != rows.size() || !file.commit()) {
+        qWarning("unable to write the estimates to '%s'.", qPrintable(m_ciOutput));
+    }
+}
+
+void FollowFlee::initReplicas()
+{
+    ReplicaBatch& batch = m_replicas;
+    m_sweepOutput.reset();
+    if (batch.size <= 0) {
+        return;
+    }
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+    const size_t numSlots = static_cast<size_t>(m_topology->size());
+
+    batch.cells.clear();
+    batch.cells.reserve(nodes().size());
+    for (Node node : nodes()) {
+        batch.cells.emplace_back(cellOf(node));
+    }
+    std::sort(batch.cells.begin(), batch.cells.end());
+    batch.cellsById = batch.cells;
+    std::sort(batch.cellsById.begin(), batch.cellsById.end(),
+        [&](int a, int b) { return m_topology->nodeId(a) < m_topology->nodeId(b); });
+    batch.idRanks.assign(numSlots, 0);
+    for (size_t k = 0; k < batch.cellsById.size(); ++k) {
+        batch.idRanks[batch.cellsById[k]] = static_cast<int>(k);
+    }
+
+    batch.strategies.assign(numSlots * numReplicas, 0);
+    batch.actions.assign(numSlots * numReplicas, 0);
+    batch.scores.assign(numSlots * numReplicas, 0);
+    batch.agents.assign(numSlots * numReplicas, 0);
+    batch.streams.assign(numSlots * numReplicas, 0);
+    batch.targets.assign(numSlots * numReplicas, 0);
+    batch.claimKeys.assign(numSlots * numReplicas, 0);
+    batch.claims.reset(new std::atomic<quint64>[numSlots * numReplicas]);
+    for (size_t i = 0; i < numSlots * numReplicas; ++i) {
+        batch.claims[i].store(0, std::memory_order_relaxed);
+    }
+    batch.cooperatorFractions.assign(numReplicas, 0.0);
+    batch.meanScores.assign(numReplicas, 0.0);
+
+    // each replica has its own PRG, seeded by its id (see replicaSeed()); so,
+    // a replica gives the same results in any batch; in a sweep, the points
+    // share the seeds, ie, the replicate k of each point uses the same numbers
+    batch.generation = 0;
+    batch.estimates.assign(batch.pointParams.size(), ReplicaBatch::Estimate());
+    batch.params.assign(numReplicas, batch.pointParams.front());
+    batch.points.assign(numReplicas, -1);
+    batch.ids.assign(numReplicas, 0);
+    batch.prgs.clear();
+    batch.prgs.resize(numReplicas);
+    batch.crnKeys.assign(numReplicas, 0);
+    for (size_t r = 0; r < numReplicas; ++r) {
+        startReplica(r, static_cast<int>(r) / batch.replicates);
+    }
+    m_pendingPoints = static_cast<int>(batch.pointParams.size());
+
+    writeFirstReplica();
 
-bool FollowFlee::init()
+    // all replicas of all generations go to a single CSV file
+    const QString sweepOutput = attr("sweepOutput", "").toString();
+    if (!sweepOutput.isEmpty()) {
+        m_sweepOutput.reset(new QFile(sweepOutput));
+        if (!m_sweepOutput->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning("unable to write the sweep output '%s'.", qPrintable(sweepOutput));
+            m_sweepOutput.reset();
+        } else {
+            m_sweepOutput->write("step,replica,repMode,repRate,stepsPerGen,density,"
+                                 "agents,cooperatorFraction,meanScore\n");
+        }
+    }
+}
+
+unsigned FollowFlee::replicaSeed(size_t replica) const
 {
-    m_repMode = repModeFromString(attr("repMode", "").toString());
-    m_repRate = attr("repRate", -1.0).toDouble();
-    m_stepsPerGen = attr("stepsPerGen", -1).toInt();
+    return static_cast<unsigned>(prg()->seed()) + static_cast<unsigned>(m_replicas.ids[replica]);
+}
 
-    return m_repRate > -1 && m_stepsPerGen > -1;
+bool FollowFlee::replicasStep()
+{
+    ReplicaBatch& batch = m_replicas;
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+    Counters counters;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (m_perf) m_perf->start();
+    replicaSteps(counters);
+    if (m_perf) {
+        m_perf->stop(m_stepReadings);
+        m_stepReadings.partial = parallelism() > 1;
+    }
+    m_stepNsecs = timer.nsecsElapsed();
+
+    // the replicas are independent; so, their replacement phases run in parallel,
+    // one replica per task, as their cost varies (eg, in a sweep of repRate)
+    std::vector<Counters> replicaCounters(numReplicas);
+    std::vector<quint64> numAgents(numReplicas, 0);
+    const int replacementChunks = m_inBranch ? 1 : batch.size;
+    timer.start();
+    if (m_perf) m_perf->start();
+    parallelFor(numReplicas, replacementChunks, [&](size_t first, size_t last, int) {
+        for (size_t r = first; r < last; ++r) {
+            qint64 totalScore = 0;
+            for (int cell : batch.cells) {
+                const size_t i = cell * numReplicas + r;
+                if (batch.strategies[i] != 0) {
+                    ++numAgents[r];
+                    totalScore += batch.scores[i];
+                }
+            }
+            if (numAgents[r] == 0) {
+                batch.meanScores[r] = 0.0;
+                batch.cooperatorFractions[r] = 0.0;
+                continue;
+            }
+            batch.meanScores[r] = static_cast<double>(totalScore) / numAgents[r];
+
+            auto agentsToReplace = static_cast<quint32>(floor(numAgents[r] * batch.params[r].repRate));
+            if (agentsToReplace > 0) {
+                replicaReplacement(static_cast<int>(r), agentsToReplace, replicaCounters[r]);
+            }
+
+            size_t cooperators = 0;
+            for (int cell : batch.cells) {
+                cooperators += batch.strategies[cell * numReplicas + r] == 1;
+            }
+            batch.cooperatorFractions[r] = static_cast<double>(cooperators) / numAgents[r];
+        }
+    });
+    if (m_perf) {
+        m_perf->stop(m_repReadings);
+        m_repReadings.partial = replacementChunks > 1;
+    }
+    m_replacementNsecs = timer.nsecsElapsed();
+
+    // the observables are the means over the (running) replicas
+    double coopSum = 0.0, coopSqSum = 0.0, scoreSum = 0.0, scoreSqSum = 0.0;
+    size_t running = 0;
+    quint64 runningAgents = 0;
+    for (size_t r = 0; r < numReplicas; ++r) {
+        m_agentSteps += numAgents[r] * static_cast<quint64>(batch.params[r].stepsPerGen);
+        counters.merge(replicaCounters[r]);
+        if (batch.points[r] < 0) {
+            continue;
+        }
+        ++running;
+        runningAgents += numAgents[r];
+        coopSum += batch.cooperatorFractions[r];
+        coopSqSum += batch.cooperatorFractions[r] * batch.cooperatorFractions[r];
+        scoreSum += batch.meanScores[r];
+        scoreSqSum += batch.meanScores[r] * batch.meanScores[r];
+    }
+    const quint64 runningCells = running * batch.cells.size();
+    running = std::max<size_t>(running, 1);
+    m_cooperatorFraction = coopSum / running;
+    m_meanScore = scoreSum / running;
+    m_cooperatorFractionStdDev = std::sqrt(std::max(0.0, coopSqSum / running
+                                            - m_cooperatorFraction * m_cooperatorFraction));
+    m_meanScoreStdDev = std::sqrt(std::max(0.0, scoreSqSum / running - m_meanScore * m_meanScore));
+    m_counters.merge(counters);
+
+    writeFirstReplica();
+    exportGrid();
+    writeSnapshot();
+    publishTelemetry(runningAgents, runningCells - runningAgents);
+
+    if (m_sweepOutput) {
+        QByteArray rows;
+        for (size_t r = 0; r < numReplicas; ++r) {
+            if (batch.points[r] < 0) {
+                continue;
+            }
+            const ReplicaBatch::Params& p = batch.params[r];
+            rows += QByteArray::number(currStep()) + ','
+                  + QByteArray::number(static_cast<qulonglong>(batch.ids[r])) + ','
+                  + (p.repMode == SimpleBD ? "simpleBD" : "neighbourBD") + ','
+                  + QByteArray::number(p.repRate) + ',' + QByteArray::number(p.stepsPerGen) + ','
+                  + QByteArray::number(p.density) + ','
+                  + QByteArray::number(static_cast<qulonglong>(numAgents[r])) + ','
+                  + QByteArray::number(batch.cooperatorFractions[r]) + ','
+                  + QByteArray::number(batch.meanScores[r]) + '\n';
+        }
+        m_sweepOutput->write(rows);
+        m_sweepOutput->flush();
+    }
+
+    // the replicates run for a fixed number of generations in the adaptive replication
+    if (batch.replicateSteps > 0) {
+        return ++batch.generation < batch.replicateSteps || finishReplicates();
+    }
+    ++batch.generation;
+
+    // the cycle detection follows a single grid; so, only the equilibrium is checked
+    return !m_equilibrium.add({m_cooperatorFraction, m_meanScore});
 }
 
-void FollowFlee::beforeLoop()
+void FollowFlee::replicaSteps(Counters& counters)
 {
-    m_agents.clear();
-    m_emptyCells.clear();
-    m_agents.reserve(nodes().size());
+    ReplicaBatch& batch = m_replicas;
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+    const int replicas = batch.size;
+    const int numChunks = parallelism();
+    const quint32 horizonSize = graph()->attr("neighbours").toUInt();
 
-    // Find the non-empty nodes (agents)
-    for (Node node : nodes()) {
-        if (node.attr(Strategy).toInt() > 0) {
-            m_agents.emplace_back(node);
+    // the agents of each replica are numbered as in its run, whose m_agents
+    // is sorted by id at the start of the generation (see synchronousSteps())
+    std::vector<int> numAgents(numReplicas, 0);
+    for (int cell : batch.cellsById) {
+        const quint64 nodeId = static_cast<quint64>(m_topology->nodeId(cell));
+        for (size_t r = 0; r < numReplicas; ++r) {
+            const size_t i = cell * numReplicas + r;
+            if (batch.strategies[i] != 0) {
+                batch.agents[i] = numAgents[r]++;
+                batch.streams[i] = m_commonRandomNumbers ? nodeId : static_cast<quint64>(batch.agents[i]);
+            }
+        }
+    }
+
+    // one draw from each replica's PRG per generation (as in synchronousSteps());
+    // as in algorithmStep(), a run without agents does not draw
+    const int generation = batch.generation + 1;
+    std::vector<quint64> genKeys(numReplicas, 0);
+    int maxSteps = 0;
+    for (size_t r = 0; r < numReplicas; ++r) {
+        if (batch.prgs[r] && numAgents[r] > 0) {
+            genKeys[r] = generationKey(batch.prgs[r].get(), batch.crnKeys[r], generation, MoveEvent);
+            maxSteps = std::max(maxSteps, batch.params[r].stepsPerGen);
+        }
+    }
+    std::fill(batch.scores.begin(), batch.scores.end(), 0);
+
+    std::vector<Counters> chunkCounters(static_cast<size_t>(numChunks));
+    for (int step = 0; step < maxSteps; ++step) {
+        // decide: the same as in synchronousSteps(), for all replicas of a cell at once
+        parallelFor(batch.cells.size(), numChunks, [&](size_t first, size_t last, int chunk) {
+            Horizon horizon(horizonSize);
+            Counters& c = chunkCounters[chunk];
+            std::vector<int> payoffs(numReplicas);
+            std::vector<int> vacant(numReplicas);
+            for (size_t k = first; k < last; ++k) {
+                const int cell = batch.cells[k];
+                const quint8* own = &batch.strategies[cell * numReplicas];
+
+                // the payoffs and the empty neighbours of all replicas in one pass
+                std::fill(payoffs.begin(), payoffs.end(), 0);
+                std::fill(vacant.begin(), vacant.end(), 0);
+                for (int nid : m_topology->outNeighbours(cell)) {
+                    const quint8* other = &batch.strategies[nid * numReplicas];
+                    for (size_t r = 0; r < numReplicas; ++r) {
+                        payoffs[r] += gamePayoff(own[r], other[r]);
+                        vacant[r] += other[r] == 0;
+                    }
+                }
+
+                // the moves are chosen one replica at a time
+                for (size_t r = 0; r < numReplicas; ++r) {
+                    const size_t i = cell * numReplicas + r;
+                    batch.targets[i] = cell;
+                    if (own[r] == 0 || step >= batch.params[r].stepsPerGen) {
+                        continue;
+                    }
+                    batch.scores[i] += payoffs[r];
+                    if (vacant[r] == 0) {
+                        ++c.blocked;
+                        continue;
+                    }
+                    StreamRng rng(StreamRng::key(genKeys[r], static_cast<quint64>(step), batch.streams[i]));
+                    const ReplicaStrategies view{batch.strategies.data(), replicas, static_cast<int>(r)};
+                    fillHorizon(cell, horizon, view);
+                    batch.targets[i] = chooseTarget(cell, batch.actions[i], horizon, rng, c);
+                    if (batch.targets[i] == cell) {
+                        continue;
+                    }
+                    batch.claimKeys[i] = (rng.next() & 0xFFFFFFFF00000000ULL)
+                                       | static_cast<quint64>(batch.agents[i] + 1);
+                    std::atomic<quint64>& claim = batch.claims[batch.targets[i] * numReplicas + r];
+                    quint64 current = claim.load(std::memory_order_relaxed);
+                    while (current < batch.claimKeys[i] &&
+                           !claim.compare_exchange_weak(current, batch.claimKeys[i], std::memory_order_relaxed)) {}
+                }
+            }
+        });
+
+        // commit: the winners move, with their scores
+        parallelFor(batch.cells.size(), numChunks, [&](size_t first, size_t last, int chunk) {
+            Counters& c = chunkCounters[chunk];
+            for (size_t k = first; k < last; ++k) {
+                const int cell = batch.cells[k];
+                for (size_t r = 0; r < numReplicas; ++r) {
+                    const size_t i = cell * numReplicas + r;
+                    if (batch.targets[i] == cell) {
+                        continue;
+                    }
+                    const size_t j = batch.targets[i] * numReplicas + r;
+                    if (batch.claims[j].load(std::memory_order_relaxed) != batch.claimKeys[i]) {
+                        ++c.conflicts;
+                        continue;
+                    }
+                    batch.claims[j].store(0, std::memory_order_relaxed);
+                    batch.strategies[j] = batch.strategies[i];
+                    batch.actions[j] = batch.actions[i];
+                    batch.scores[j] = batch.scores[i];
+                    batch.agents[j] = batch.agents[i];
+                    batch.streams[j] = batch.streams[i];
+                    batch.strategies[i] = 0;
+                    batch.actions[i] = 0;
+                    batch.scores[i] = 0;
+                    ++c.moves;
+                }
+            }
+        });
+    }
+
+    for (const Counters& c : chunkCounters) {
+        counters.merge(c);
+    }
+}
+
+void FollowFlee::replicaReplacement(int replica, quint32 agentsToReplace, Counters& counters)
+{
+    ReplicaBatch& batch = m_replicas;
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+    PRG* prg = batch.prgs[replica].get();
+    const int generation = batch.generation + 1;
+    auto at = [&](int cell) { return cell * numReplicas + replica; };
+
+    // the agents in the order of the run's m_agents (see replicaSteps()), then
+    // by score (descending) as in sortAgentsByScore(); it is the same std::sort
+    // over the same sequence, so the ties end up in the same order
+    std::vector<int> agents;
+    for (int cell : batch.cells) {
+        if (batch.strategies[at(cell)] != 0) {
+            agents.emplace_back(cell);
+        }
+    }
+    std::sort(agents.begin(), agents.end(),
+        [&](int a, int b) { return batch.agents[at(a)] < batch.agents[at(b)]; });
+    std::sort(agents.begin(), agents.end(),
+        [&](int a, int b) { return batch.scores[at(a)] > batch.scores[at(b)]; });
+
+    // make the worst X cells available; as in simpleBD() and neighbourBD(), they
+    // can take the newborns but are not free around the parents
+    std::vector<quint8> dying(static_cast<size_t>(m_topology->size()), 0);
+    for (quint32 i = 0; i < agentsToReplace; ++i) {
+        dying[agents[agents.size() - 1 - i]] = 1;
+    }
+
+    // the available cells are counted in a Fenwick tree over cellsById; so, the
+    // k-th of them is the k-th of m_emptyCells (a map by id) in selectEmptyCell()
+    const size_t numCells = batch.cellsById.size();
+    auto lowBit = [](size_t k) { return k & (0 - k); };
+    std::vector<int> tree(numCells + 1, 0);
+    size_t available = 0;
+    for (size_t k = 0; k < numCells; ++k) {
+        const int cell = batch.cellsById[k];
+        if (batch.strategies[at(cell)] == 0 || dying[cell]) {
+            tree[k + 1] += 1;
+            ++available;
+        }
+        const size_t parent = (k + 1) + lowBit(k + 1);
+        if (parent <= numCells) {
+            tree[parent] += tree[k + 1];
+        }
+    }
+    size_t topBit = 1;
+    while (topBit * 2 <= numCells) {
+        topBit *= 2;
+    }
+    auto selectEmptyCell = [&](EventRng& rng) {
+        size_t k = rng.uniform(available - 1);
+        size_t pos = 0;
+        for (size_t bit = topBit; bit > 0; bit /= 2) {
+            if (pos + bit <= numCells && static_cast<size_t>(tree[pos + bit]) <= k) {
+                pos += bit;
+                k -= static_cast<size_t>(tree[pos]);
+            }
+        }
+        return batch.cellsById[pos];
+    };
+    auto takeCell = [&](int cell) {
+        for (size_t k = static_cast<size_t>(batch.idRanks[cell]) + 1; k <= numCells; k += lowBit(k)) {
+            tree[k] -= 1;
+        }
+        --available;
+        dying[cell] = 0;
+    };
+
+    // now we copy the best X agents, drawing from the same numbers as the run
+    std::vector<int> freeCells;
+    for (quint32 i = 0; i < agentsToReplace; ++i) {
+        const int parent = agents[i];
+        EventRng rng = eventRng(prg, batch.crnKeys[replica], generation,
+                                ReplacementEvent, m_topology->nodeId(parent));
+        int tgt;
+        if (batch.params[replica].repMode == SimpleBD) {
+            tgt = selectEmptyCell(rng);
         } else {
-            m_emptyCells.insert({node.id(), node});
+            freeCells.clear();
+            for (int nid : m_topology->outNeighbours(parent)) {
+                if (batch.strategies[at(nid)] == 0) {
+                    freeCells.emplace_back(nid);
+                }
+            }
+            if (freeCells.empty()) { // no space
+                ++counters.fallbacks;
+                tgt = selectEmptyCell(rng);
+            } else {
+                tgt = freeCells.at(rng.uniform(freeCells.size() - 1));
+            }
+        }
+        takeCell(tgt);
+        batch.strategies[at(tgt)] = batch.strategies[at(parent)];
+        batch.actions[at(tgt)] = batch.actions[at(parent)];
+        batch.scores[at(tgt)] = batch.scores[at(parent)];
+    }
+
+    // the dying cells which did not take a newborn become empty
+    for (quint32 i = 0; i < agentsToReplace; ++i) {
+        const int cell = agents[agents.size() - 1 - i];
+        if (dying[cell]) {
+            batch.strategies[at(cell)] = 0;
+            batch.actions[at(cell)] = 0;
+            batch.scores[at(cell)] = 0;
         }
     }
 }
 
-bool FollowFlee::algorithmStep()
+void FollowFlee::writeFirstReplica()
 {
-    if (m_agents.empty()) {
-        return true; // nothing to do
+    const ReplicaBatch& batch = m_replicas;
+    const size_t numReplicas = static_cast<size_t>(batch.size);
+    parallelFor(batch.cells.size(), parallelism(), [&](size_t first, size_t last, int) {
+        for (size_t k = first; k < last; ++k) {
+            const int cell = batch.cells[k];
+            Node n = nodeAt(cell);
+            n.setAttr(Strategy, batch.strategies[cell * numReplicas]);
+            n.setAttr(Actions, batch.actions[cell * numReplicas]);
+            n.setAttr(Score, batch.scores[cell * numReplicas]);
+        }
+    });
+}
+
+void FollowFlee::asynchronousSteps(Counters& counters)
+{
+    const size_t numAgents = m_agents.size();
+    const int numChunks = parallelism();
+    const quint32 horizonSize = graph()->attr("neighbours").toUInt();
+    const quint64 genKey = generationKey(MoveEvent);
+
+    // the occupancy array shared by the workers
+    const AtomicStrategies occupancy{m_occupancy.get()};
+    for (int id = 0; id < m_topology->size(); ++id) {
+        m_occupancy[id].store(m_strategies[id], std::memory_order_relaxed);
     }
 
-    // sort agents by id
-    // it's important to ensure the same initial condition before shuffling
-    // otherwise, the play and step-by-step buttons will lead to different outputs
-    std::sort(m_agents.begin(), m_agents.end(),
-        [](Node i,Node j) { return i.id() <  j.id(); });
+    // the agents' state, by position in m_agents
+    std::vector<int> origins(numAgents);
+    std::vector<int> cells(numAgents);
+    std::vector<int> scores(numAgents, 0);
+    std::vector<quint64> streams(numAgents);
+    for (size_t i = 0; i < numAgents; ++i) {
+        origins[i] = cells[i] = cellOf(m_agents[i]);
+        streams[i] = m_commonRandomNumbers ? static_cast<quint64>(m_agents[i].id()) : i;
+    }
+
+    // each worker takes a contiguous chunk of the shuffled agents
+    std::vector<Counters> chunkCounters(static_cast<size_t>(numChunks));
+    parallelFor(numAgents, numChunks, [&](size_t first, size_t last, int chunk) {
+        Horizon horizon(horizonSize);
+        Counters& c = chunkCounters[chunk];
+        for (size_t i = first; i < last; ++i) {
+            const quint8 strategy = m_strategies[origins[i]];
+            const quint8 actions = m_actions[origins[i]];
+            for (int step = 0; step < m_stepsPerGen; ++step) {
+                StreamRng rng(StreamRng::key(genKey, static_cast<quint64>(step), streams[i]));
+                scores[i] += fillHorizon(cells[i], horizon, occupancy);
+                // only the final decision is counted
+                Counters decision;
+                int target = chooseTarget(cells[i], actions, horizon, rng, decision);
+                // claim the target cell; if someone else got there first,
+                // decide again from the updated horizon
+                quint8 expected = 0;
+                while (target != cells[i] &&
+                       !m_occupancy[target].compare_exchange_strong(expected, strategy)) {
+                    ++c.conflicts;
+                    expected = 0;
+                    fillHorizon(cells[i], horizon, occupancy);
+                    decision = Counters();
+                    target = chooseTarget(cells[i], actions, horizon, rng, decision);
+                }
+                c.merge(decision);
+                if (target != cells[i]) {
+                    m_occupancy[cells[i]].store(0);
+                    cells[i] = target;
+                    ++c.moves;
+                }
+            }
+        }
+    });
 
-    // shuffle the vector of ids
-    Utils::shuffle(m_agents, prg());
+    // update the mirrors; the origins first, as an origin might be someone else's target
+    std::vector<quint8> actions(numAgents);
+    for (size_t i = 0; i < numAgents; ++i) {
+        actions[i] = m_actions[origins[i]];
+        m_actions[origins[i]] = 0;
+    }
+    for (size_t i = 0; i < numAgents; ++i) {
+        m_actions[cells[i]] = actions[i];
+    }
+    for (int id = 0; id < m_topology->size(); ++id) {
+        m_strategies[id] = m_occupancy[id].load(std::memory_order_relaxed);
+    }
 
-    // A convenient struct to hold the neighbourhood state.
-    // As it's a regular graph, let's create it only once, reserve enough
-    // space and reuse the same object (clear) when necessary.
-    Horizon horizon(graph()->attr("neighbours").toUInt());
+    writeBack(origins, cells, scores, numChunks);
+    for (const Counters& c : chunkCounters) {
+        counters.merge(c);
+    }
+}
 
-    // for each agent in the population
-    for (Node& agent : m_agents) {
-        // reset score
-        agent.setAttr(Score, 0);
+void FollowFlee::speculativeSteps(Counters& counters)
+{
+    const int numChunks = parallelism();
+    const size_t window = static_cast<size_t>(numChunks) * SpeculativeWindow;
+    const size_t maxVisited = static_cast<size_t>(m_stepsPerGen) + 1;
+    const quint32 horizonSize = graph()->attr("neighbours").toUInt();
 
-        // the agent takes s steps per generation
-        for (int step = 0; step < m_stepsPerGen; ++step) {
-            updateScoreAndHorizon(agent, horizon);
-            updatePosition(agent, horizon);
+    std::vector<Speculation> specs(window);
+    std::vector<int> visited(window * maxVisited);
+    Horizon horizon(horizonSize);
+
+    for (size_t begin = 0; begin < m_agents.size(); begin += window) {
+        const size_t size = std::min(window, m_agents.size() - begin);
+        ++m_dirtyStamp;
+
+        // speculate: every agent of the window runs against the grid
+        // as it was at the beginning of the window
+        parallelFor(size, numChunks, [&](size_t first, size_t last, int) {
+            Horizon h(horizonSize);
+            for (size_t k = first; k < last; ++k) {
+                speculate(cellOf(m_agents[begin + k]), h, specs[k], &visited[k * maxVisited]);
+            }
+        });
+
+        // validate and commit in the sequential order; an agent is replayed
+        // if it needs random numbers (which must be drawn in order) or if an
+        // earlier agent of the window changed a cell it has read
+        for (size_t k = 0; k < size; ++k) {
+            Node& agent = m_agents[begin + k];
+            const Speculation& spec = specs[k];
+            const int origin = cellOf(agent);
+
+            bool valid = !spec.usedRng;
+            for (int v = 0; valid && v < spec.numVisited; ++v) {
+                valid = m_dirty[visited[k * maxVisited + v]] != m_dirtyStamp;
+            }
+
+            if (valid) {
+                Counters ignored; // the moves were counted by the speculation
+                move(agent, spec.target, ignored);
+                agent.setAttr(Score, spec.score);
+                counters.moves += static_cast<quint64>(spec.numVisited - 1);
+                counters.blocked += static_cast<quint64>(spec.blocked);
+                counters.uniqueMax += static_cast<quint64>(spec.uniqueMax);
+            } else {
+                ++counters.replays;
+                runAgent(agent, horizon, counters);
+            }
+
+            if (cellOf(agent) != origin) {
+                markDirty(origin);
+                markDirty(cellOf(agent));
+            }
         }
     }
+}
 
-    // replacement phase; prepares the next generation
-    auto agentsToReplace = static_cast<quint32>(floor(m_agents.size() * m_repRate));
-    if (agentsToReplace > 0) {
-        if (m_repMode == SimpleBD) {
-            simpleBD(agentsToReplace);
-        } else if (m_repMode == NeighbourBD) {
-            neighbourBD(agentsToReplace);
-        } else {
-            qFatal("the replacement mode is invalid!");
+void FollowFlee::speculate(int origin, Horizon& horizon, Speculation& spec, int* visited) const
+{
+    spec = Speculation();
+    spec.target = origin;
+    visited[spec.numVisited++] = origin;
+
+    // same fast path as in runAgent()
+    if (m_vacantNeighbours[origin] == 0) {
+        spec.score = payoff(origin) * m_stepsPerGen;
+        spec.blocked = m_stepsPerGen;
+        return;
+    }
+
+    OverlayStrategies view{m_strategies.data(), origin, origin, m_strategies[origin]};
+    SpeculativeRng rng;
+    Counters counters;
+    for (int step = 0; step < m_stepsPerGen; ++step) {
+        spec.score += fillHorizon(view.current, horizon, view);
+        const int target = chooseTarget(view.current, m_actions[origin], horizon, rng, counters);
+        if (rng.used) {
+            spec.usedRng = true;
+            return;
+        }
+        if (target != view.current) {
+            view.current = target;
+            visited[spec.numVisited++] = target;
         }
     }
+    spec.target = view.current;
+    spec.blocked = static_cast<int>(counters.blocked);
+    spec.uniqueMax = static_cast<int>(counters.uniqueMax);
+}
 
-    return true;
+void FollowFlee::markDirty(int id)
+{
+    // the cell itself and all cells having it in their horizon
+    m_dirty[id] = m_dirtyStamp;
+    for (int nid : m_topology->inNeighbours(id)) {
+        m_dirty[nid] = m_dirtyStamp;
+    }
 }
 
-void FollowFlee::updateScoreAndHorizon(Node& agent, Horizon& horizon) const
+void FollowFlee::writeBack(const std::vector<int>& origins, const std::vector<int>& cells,
+                           const std::vector<int>& scores, int numChunks)
 {
-    horizon.clear();
+    const size_t numAgents = m_agents.size();
 
-    // the agent can stay still; so, it's a free cell too!
-    // important: the center cell is always the first!
-    horizon.freeCells.push_back({agent.id(), 0});
+    // write the new grid back to the nodes; first clear the cells left behind,
+    // then fill the occupied ones (an origin might be someone else's target)
+    std::vector<quint64> chunkHashes(static_cast<size_t>(numChunks), 0);
+    parallelFor(numAgents, numChunks, [&](size_t first, size_t last, int chunk) {
+        for (size_t i = first; i < last; ++i) {
+            if (origins[i] == cells[i]) {
+                continue;
+            }
+            Node n = nodeAt(origins[i]);
+            n.setAttr(Strategy, 0);
+            n.setAttr(Actions, 0);
+            n.setAttr(Score, 0);
+            chunkHashes[chunk] ^= cellKey(origins[i], m_strategies[cells[i]], m_actions[cells[i]]);
+            chunkHashes[chunk] ^= cellKey(cells[i], m_strategies[cells[i]], m_actions[cells[i]]);
+        }
+    });
+    parallelFor(numAgents, numChunks, [&](size_t first, size_t last, int) {
+        for (size_t i = first; i < last; ++i) {
+            Node n = nodeAt(cells[i]);
+            if (origins[i] != cells[i]) {
+                n.setAttr(Strategy, m_strategies[cells[i]]);
+                n.setAttr(Actions, m_actions[cells[i]]);
+            }
+            n.setAttr(Score, scores[i]);
+            m_agents[i] = n;
+        }
+    });
 
-    const int strA = agent.attr(Strategy).toInt();
-    int score = agent.attr(Score).toInt();
-    for (Node neighbour : agent.outEdges()) {
-        int strB = neighbour.attr(Strategy).toInt();
+    // the vacancy counters are rebuilt from scratch (it is a parallel read-only pass)
+    parallelFor(static_cast<size_t>(m_topology->size()), numChunks, [&](size_t first, size_t last, int) {
+        for (size_t id = first; id < last; ++id) {
+            quint16 vacant = 0;
+            for (int nid : m_topology->outNeighbours(static_cast<int>(id))) {
+                vacant += m_strategies[nid] == 0;
+            }
+            m_vacantNeighbours[id] = vacant;
+        }
+    });
 
-        // this cell is empty
-        if (strB == 0) {
-            horizon.freeCells.push_back({neighbour.id(), 0});
-            continue;
+    for (size_t i = 0; i < numAgents; ++i) {
+        if (origins[i] != cells[i]) {
+            m_emptyCells.insert({m_topology->nodeId(origins[i]), nodeAt(origins[i])});
+        }
+    }
+    for (size_t i = 0; i < numAgents; ++i) {
+        if (origins[i] != cells[i]) {
+            m_emptyCells.erase(m_topology->nodeId(cells[i]));
         }
+    }
 
-        // accumulate the score received by playing the
-        // prisoner's dilemma game with all neighbours
-        score += playGame(strA, strB);
+    for (quint64 hash : chunkHashes) {
+        m_stateHash ^= hash;
+    }
+}
 
-        // keep track of the neighbourhood state
-        if (strB == 1) {
-            horizon.cooperators.emplace_back(neighbour);
+void FollowFlee::memoisedStep(Node& agent, Horizon& horizon, EventRng& rng, Counters& counters)
+{
+    const quint64 signature = horizonSignature(agent);
+    StepMemo& memo = m_memo[cellOf(agent)];
+
+    if (signature != InvalidSignature && signature == memo.signature) {
+        ++counters.memoHits;
+        agent.setAttr(Score, agent.attr(Score).toInt() + memo.payoff);
+        if (memo.blocked) {
+            ++counters.blocked;
         } else {
-            horizon.defectors.emplace_back(neighbour);
+            ++counters.uniqueMax;
+            move(agent, memo.target, counters);
         }
+        return;
     }
 
-    // update the agent's score
-    agent.setAttr(Score, score);
+    ++counters.memoMisses;
+    const int prevScore = agent.attr(Score).toInt();
+    const quint64 prevDraws = counters.randomMoves + counters.ties + counters.randomActions;
+    const quint64 prevBlocked = counters.blocked;
+
+    updateScoreAndHorizon(agent, horizon);
+    updatePosition(agent, horizon, rng, counters);
+
+    // only the steps without random draws can be replayed
+    if (signature != InvalidSignature &&
+            prevDraws == counters.randomMoves + counters.ties + counters.randomActions) {
+        memo.signature = signature;
+        memo.payoff = agent.attr(Score).toInt() - prevScore;
+        memo.target = cellOf(agent);
+        memo.blocked = counters.blocked != prevBlocked;
+    }
+}
+
+quint64 FollowFlee::horizonSignature(const Node& agent) const
+{
+    const int cell = cellOf(agent);
+    const Topology::Ids neighbours = m_topology->outNeighbours(cell);
+    if (neighbours.size() > 24) {
+        return InvalidSignature;
+    }
+
+    // bits 0-47: neighbours; bits 48-55: actions; bits 56-57: strategy
+    quint64 signature = static_cast<quint64>(m_strategies[cell]) << 56;
+    signature |= static_cast<quint64>(m_actions[cell]) << 48;
+    int shift = 0;
+    for (int nid : neighbours) {
+        signature |= static_cast<quint64>(m_strategies[nid]) << shift;
+        shift += 2;
+    }
+    return signature;
+}
+
+void FollowFlee::updatePosition(Node& agent, Horizon& horizon, EventRng& rng, Counters& counters)
+{
+    const int cell = cellOf(agent);
+    move(agent, chooseTarget(cell, m_actions[cell], horizon, rng, counters), counters);
 }
 
-void FollowFlee::updatePosition(Node& agent, Horizon& horizon)
+template<typename Rng>
+int FollowFlee::chooseTarget(int id, quint8 actionBits, Horizon& horizon, Rng& rng,
+                             Counters& counters) const
 {
-    Q_ASSERT_X(horizon.freeCells.size() > 0, "updatePosition",
+    Q_ASSERT_X(horizon.freeCells.size() > 0, "chooseTarget",
         "freeCells counts the agent itself, so the size is always >0");
 
     if (horizon.freeCells.size() == 1) {
-        return; // no place to go!
+        ++counters.blocked;
+        return id; // no place to go!
     }
 
-    size_t numNeighbours = agent.outEdges().size() - (horizon.freeCells.size() - 1);
+    size_t numNeighbours = m_topology->outNeighbours(id).size() - (horizon.freeCells.size() - 1);
 
     // no neighbours? move at random!
     if (numNeighbours == 0) {
-        move(agent, horizon.freeCells.at(prg()->uniform(horizon.freeCells.size()-1)).id);
-        return;
+        ++counters.randomMoves;
+        return horizon.freeCells.at(rng.uniform(horizon.freeCells.size()-1)).id;
     }
 
     // convert decimal to 8-bit
     // important! in a bitset, the order positions are counted from right to left
-    const std::bitset<8> actions(agent.attr(Actions).toUInt());
+    const std::bitset<8> actions(actionBits);
 
     // evaluate the free cells based on the neighbourhood state
     if (numNeighbours == horizon.cooperators.size()) { // only cooperators
         evalFreeCells(horizon.freeCells, horizon.cooperators,
-                      actions[7] * 2 + actions[6]);
+                      actions[7] * 2 + actions[6], rng, counters);
     } else if (numNeighbours == horizon.defectors.size()) { // only defectors
         evalFreeCells(horizon.freeCells, horizon.defectors,
-                      actions[5] * 2 + actions[4]);
+                      actions[5] * 2 + actions[4], rng, counters);
     } else { // cooperators and defectors
         evalFreeCells(horizon.freeCells, horizon.cooperators,
-                      actions[3] * 2 + actions[2]);
+                      actions[3] * 2 + actions[2], rng, counters);
         evalFreeCells(horizon.freeCells, horizon.defectors,
-                      actions[1] * 2 + actions[0]);
+                      actions[1] * 2 + actions[0], rng, counters);
+    }
+
+    // finally, pick the position!
+    return horizon.freeCells.at(pickHighestScore(horizon.freeCells, rng, counters)).id;
+}
+
+template<typename Rng>
+size_t FollowFlee::pickHighestScore(const std::vector<FreeCell>& freeCells, Rng& rng,
+                                    Counters& counters) const
+{
+    Q_ASSERT(!freeCells.empty());
+
+    if (freeCells.size() > 64) {
+        // too many cells for the bitmask; pick the free cells with the highest score
+        int highestScore = INT32_MIN;
+        std::vector<size_t> highestScoreIdxs;
+        highestScoreIdxs.reserve(freeCells.size());
+        for (size_t i = 0; i < freeCells.size(); ++i) {
+            if (freeCells[i].score > highestScore) {
+                highestScore = freeCells[i].score;
+                highestScoreIdxs.clear();
+                highestScoreIdxs.emplace_back(i);
+            } else if (freeCells[i].score == highestScore) {
+                highestScoreIdxs.emplace_back(i);
+            }
+        }
+        if (highestScoreIdxs.size() == 1) {
+            ++counters.uniqueMax;
+            return highestScoreIdxs.front();
+        }
+        ++counters.ties;
+        return highestScoreIdxs.at(rng.uniform(highestScoreIdxs.size()-1));
     }
 
-    // pick the free cells with the highest score
+    // single pass: keep the highest score and a bitmask of the cells holding it;
+    // the conditional assignments compile to cmovs, so the loop does not branch on the scores
     int highestScore = INT32_MIN;
-    std::vector<int> highestScoreIds;
-    highestScoreIds.reserve(horizon.freeCells.size());
-    for (auto fc : horizon.freeCells) {
-        if (fc.score > highestScore) {
-            highestScore = fc.score;
-            highestScoreIds.clear();
-            highestScoreIds.emplace_back(fc.id);
-        } else if (fc.score == highestScore) {
-            highestScoreIds.emplace_back(fc.id);
-        }
-    }
-
-    // finally, set the position!
-    Q_ASSERT(highestScoreIds.size() > 0);
-    if (highestScoreIds.size() == 1) {
-        move(agent, highestScoreIds.front());
-    } else {
-        move(agent, highestScoreIds.at(prg()->uniform(highestScoreIds.size()-1)));
+    quint64 mask = 0;
+    for (size_t i = 0; i < freeCells.size(); ++i) {
+        const int score = freeCells[i].score;
+        const quint64 bit = quint64(1) << i;
+        mask = score > highestScore ? bit : (score == highestScore ? mask | bit : mask);
+        highestScore = score > highestScore ? score : highestScore;
     }
+
+    const int numTies = popCount(mask);
+    if (numTies == 1) {
+        ++counters.uniqueMax;
+        return static_cast<size_t>(countTrailingZeros(mask));
+    }
+
+    // the k-th tied cell (in the freeCells order) with a single draw,
+    // ie, the same choice as indexing a list of the tied cells
+    ++counters.ties;
+    int k = rng.uniform(numTies-1);
+    for (; k > 0; --k) {
+        mask &= mask - 1; // clear the lowest set bit
+    }
+    return static_cast<size_t>(countTrailingZeros(mask));
 }
 
 void FollowFlee::simpleBD(quint32 agentsToReplace)
@@ -185,7 +2092,8 @@ void FollowFlee::simpleBD(quint32 agentsToReplace)
     // now we copy the best X agents and place them randomly on the grid
     for (quint32 i = 0; i < agentsToReplace; ++i) {
         // choose an empty cell at random
-        Node tgt = selectEmptyCell();
+        EventRng rng = eventRng(ReplacementEvent, m_agents.at(i).id());
+        Node tgt = selectEmptyCell(rng);
 
         // make this cell active
         m_emptyCells.erase(tgt.id());
@@ -200,7 +2108,7 @@ void FollowFlee::simpleBD(quint32 agentsToReplace)
     }
 }
 
-void FollowFlee::neighbourBD(quint32 agentsToReplace)
+void FollowFlee::neighbourBD(quint32 agentsToReplace, Counters& counters)
 {
     sortAgentsByScore(m_agents);
 
@@ -217,6 +2125,7 @@ void FollowFlee::neighbourBD(quint32 agentsToReplace)
     // now we copy the best X agents and place the copies randomly around the parent
     for (quint32 i = 0; i < agentsToReplace; ++i) {
         Node parent = m_agents.at(i);
+        EventRng rng = eventRng(ReplacementEvent, parent.id());
 
         // checks if the parent has free cells around
         freeCells.clear();
@@ -227,9 +2136,10 @@ void FollowFlee::neighbourBD(quint32 agentsToReplace)
 
         Node tgt;
         if (freeCells.empty()) { // no space
-            tgt = selectEmptyCell(); // random
+            ++counters.fallbacks;
+            tgt = selectEmptyCell(rng); // random
         } else {
-            tgt = freeCells.at(prg()->uniform(freeCells.size()-1));
+            tgt = freeCells.at(rng.uniform(freeCells.size()-1));
         }
 
         // make this cell active
@@ -261,10 +2171,11 @@ int FollowFlee::playGame(int strA, int strB) const
     }
 }
 
-void FollowFlee::move(Node& agent, int targetId)
+void FollowFlee::move(Node& agent, int target, Counters& counters)
 {
-    if (agent.id() != targetId) {
-        Node tgt = node(targetId);
+    if (cellOf(agent) != target) {
+        ++counters.moves;
+        Node tgt = nodeAt(target);
         m_emptyCells.erase(tgt.id());
         copyAttrs(agent, tgt);
         clearAttrs(agent);
@@ -273,41 +2184,173 @@ void FollowFlee::move(Node& agent, int targetId)
     }
 }
 
-Node FollowFlee::selectEmptyCell() const
+Node FollowFlee::selectEmptyCell(EventRng& rng) const
 {
-    size_t itPos = prg()->uniform(m_emptyCells.size()-1);
+    size_t itPos = rng.uniform(m_emptyCells.size()-1);
     return std::next(m_emptyCells.cbegin(), itPos)->second;
 }
 
-void FollowFlee::copyAttrs(Node& src, Node& tgt) const
+FollowFlee::EventRng FollowFlee::eventRng(RandomEvent event, int id)
+{
+    return eventRng(generator(), m_crnKey, m_generation, event, id);
+}
+
+FollowFlee::EventRng FollowFlee::eventRng(PRG* prg, quint64 crnKey, int generation,
+                                          RandomEvent event, int id) const
+{
+    if (!m_commonRandomNumbers) {
+        return {prg, StreamRng(0)};
+    }
+    return {nullptr, StreamRng(StreamRng::key(crnKey, static_cast<quint64>(event),
+                                              static_cast<quint64>(generation), static_cast<quint64>(id)))};
+}
+
+quint64 FollowFlee::generationKey(RandomEvent event)
+{
+    return generationKey(generator(), m_crnKey, m_generation, event);
+}
+
+quint64 FollowFlee::generationKey(PRG* prg, quint64 crnKey, int generation, RandomEvent event) const
+{
+    if (!m_commonRandomNumbers) {
+        return static_cast<quint64>(prg->uniform(INT32_MAX));
+    }
+    return StreamRng::key(crnKey, static_cast<quint64>(event), static_cast<quint64>(generation),
+                          ~quint64(0)); // not a node id
+}
+
+void FollowFlee::shuffleAgents()
+{
+    if (!m_commonRandomNumbers) {
+        Utils::shuffle(m_agents, generator());
+        return;
+    }
+
+    const quint64 orderKey = generationKey(OrderEvent);
+    std::vector<std::pair<quint64, Node>> ranked;
+    ranked.reserve(m_agents.size());
+    for (const Node& agent : m_agents) {
+        ranked.emplace_back(StreamRng::key(orderKey, static_cast<quint64>(agent.id())), agent);
+    }
+    std::sort(ranked.begin(), ranked.end(),
+        [](const std::pair<quint64, Node>& a, const std::pair<quint64, Node>& b) {
+            return a.first < b.first || (a.first == b.first && a.second.id() < b.second.id());
+        });
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        m_agents[i] = ranked[i].second;
+    }
+}
+
+void FollowFlee::copyAttrs(Node& src, Node& tgt)
 {
+    const int srcCell = cellOf(src);
+    const int tgtCell = cellOf(tgt);
+    m_stateHash ^= cellKey(tgtCell, m_strategies[tgtCell], m_actions[tgtCell]);
+    m_stateHash ^= cellKey(tgtCell, m_strategies[srcCell], m_actions[srcCell]);
     tgt.setAttr(Strategy, src.attr(Strategy));
     tgt.setAttr(Actions, src.attr(Actions));
     tgt.setAttr(Score, src.attr(Score));
+    m_actions[tgtCell] = m_actions[srcCell];
+    setStrategy(tgtCell, m_strategies[srcCell]);
 }
 
 void FollowFlee::clearAttrs(Node& agent)
 {
+    const int cell = cellOf(agent);
+    m_stateHash ^= cellKey(cell, m_strategies[cell], m_actions[cell]);
     agent.setAttr(Strategy, 0);
     agent.setAttr(Actions, 0);
     agent.setAttr(Score, 0);
+    m_actions[cell] = 0;
+    setStrategy(cell, 0);
+}
+
+void FollowFlee::setStrategy(int id, quint8 strategy)
+{
+    const bool wasOccupied = m_strategies[id] != 0;
+    const bool occupied = strategy != 0;
+    m_strategies[id] = strategy;
+    if (wasOccupied == occupied) {
+        return;
+    }
+    for (int nid : m_topology->inNeighbours(id)) {
+        if (occupied) {
+            --m_vacantNeighbours[nid];
+        } else {
+            ++m_vacantNeighbours[nid];
+        }
+    }
+}
+
+quint64 FollowFlee::cellKey(int id, int strategy, int actions)
+{
+    if (strategy == 0) {
+        return 0; // empty cells do not contribute to the hash
+    }
+    // the keys are derived on the fly (splitmix64) instead of stored in a table
+    return StreamRng::mix((static_cast<quint64>(id) << 10) | (static_cast<quint64>(strategy) << 8)
+                          | static_cast<quint64>(actions & 0xFF));
+}
+
+bool FollowFlee::detectCycle()
+{
+    // the model is stochastic, so a single repetition is not enough;
+    // the state must repeat with the same period for a few periods in a row
+    int period = 0;
+    const int histSize = static_cast<int>(m_hashHistory.size());
+    for (int p = 1; p <= MaxCyclePeriod && p <= histSize; ++p) {
+        if (m_hashHistory[histSize - p] == m_stateHash) {
+            period = p;
+            break;
+        }
+    }
+
+    if (period == 0) {
+        m_cycleRun = 0;
+        m_cyclePeriod = 0;
+    } else if (period == m_cyclePeriod) {
+        ++m_cycleRun;
+    } else {
+        m_cyclePeriod = period;
+        m_cycleRun = 1;
+    }
+
+    m_hashHistory.emplace_back(m_stateHash);
+    if (m_hashHistory.size() > MaxCyclePeriod) {
+        m_hashHistory.erase(m_hashHistory.begin());
+    }
+
+    return m_cyclePeriod > 0 && m_cycleRun >= m_cyclePeriod * CycleRepeats;
+}
+
+int FollowFlee::payoff(int id) const
+{
+    const int strA = m_strategies[id];
+    int score = 0;
+    for (int nid : m_topology->outNeighbours(id)) {
+        score += playGame(strA, m_strategies[nid]);
+    }
+    return score;
 }
 
+template<typename Rng>
 void FollowFlee::evalFreeCells(std::vector<FreeCell>& freeCells,
-        const std::vector<Node>& neighbours, quint8 action) const
+        const std::vector<int>& neighbours, quint8 action,
+        Rng& rng, Counters& counters) const
 {
     switch (action) {
     case 0:
         stayStill(freeCells, static_cast<int>(neighbours.size()));
         return;
     case 1:
-        for (const Node& n : neighbours) follow(freeCells, n);
+        for (int nid : neighbours) follow(freeCells, nid);
         return;
     case 2:
-        for (const Node& n : neighbours) flee(freeCells, n);
+        for (int nid : neighbours) flee(freeCells, nid);
         return;
     case 3:
-        random(freeCells, static_cast<int>(neighbours.size()));
+        ++counters.randomActions;
+        random(freeCells, static_cast<int>(neighbours.size()), rng);
         return;
     default:
          qFatal("Error! Invalid action (%d)", action);
@@ -322,12 +2365,13 @@ void FollowFlee::stayStill(std::vector<FreeCell>& freeCells, int numNeighbours)
     }
 }
 
-void FollowFlee::follow(std::vector<FreeCell>& freeCells, const Node& neighbour) const
+void FollowFlee::follow(std::vector<FreeCell>& freeCells, int neighbourId) const
 {
     // the intersecting neighbours sum one and the others sum zero
+    const Topology::Ids neighbours = m_topology->outNeighbours(neighbourId);
     for (auto& fc : freeCells) {
-        for (const Node& n : neighbour.outEdges()) {
-            if (fc.id == n.id()) {
+        for (int nid : neighbours) {
+            if (fc.id == nid) {
                 fc.score += 1;
                 break;
             }
@@ -335,13 +2379,14 @@ void FollowFlee::follow(std::vector<FreeCell>& freeCells, const Node& neighbour)
     }
 }
 
-void FollowFlee::flee(std::vector<FreeCell>& freeCells, const Node& neighbour) const
+void FollowFlee::flee(std::vector<FreeCell>& freeCells, int neighbourId) const
 {
     // the intersecting neighbours sum zero and the others sum one
+    const Topology::Ids neighbours = m_topology->outNeighbours(neighbourId);
     for (auto& fc : freeCells) {
         bool intersects = false;
-        for (const Node& n : neighbour.outEdges()) {
-            if (fc.id == n.id()) {
+        for (int nid : neighbours) {
+            if (fc.id == nid) {
                 intersects = true;
                 break;
             }
@@ -350,15 +2395,16 @@ void FollowFlee::flee(std::vector<FreeCell>& freeCells, const Node& neighbour) c
     }
 }
 
-void FollowFlee::random(std::vector<FreeCell>& freeCells, int numNeighbours) const
+template<typename Rng>
+void FollowFlee::random(std::vector<FreeCell>& freeCells, int numNeighbours, Rng& rng) const
 {
     // all neighbours sum randomly (ie, -1, 0 or +1 for each neighbour)
     for (auto& fc : freeCells) {
-        fc.score += prg()->uniform(-numNeighbours, numNeighbours);
+        fc.score += rng.uniform(-numNeighbours, numNeighbours);
     }
 }
 
-void FollowFlee::sortAgentsByScore(std::vector<Node> agents) const
+void FollowFlee::sortAgentsByScore(std::vector<Node>& agents) const
 {
     std::sort(agents.begin(), agents.end(),
         [](Node i,Node j) {
@@ -366,13 +2412,43 @@ void FollowFlee::sortAgentsByScore(std::vector<Node> agents) const
         });
 }
 
-FollowFlee::RepMode FollowFlee::repModeFromString(const QString& s)
+FollowFlee::RepMode FollowFlee::repModeFromString(const QString& s, bool* ok)
 {
+    if (ok) *ok = true;
     if (s == "simpleBD") return SimpleBD;
     if (s == "neighbourBD") return NeighbourBD;
+    if (ok) {
+        *ok = false;
+        return SimpleBD;
+    }
     qFatal("the replacement mode is invalid!");
 }
 
+FollowFlee::UpdateScheme FollowFlee::updateSchemeFromString(const QString& s)
+{
+    if (s == "randomSequential") return RandomSequential;
+    if (s == "synchronous") return Synchronous;
+    if (s == "asynchronous") return Asynchronous;
+    if (s == "speculative") return Speculative;
+    qFatal("the update scheme is invalid!");
+}
+
+FollowFlee::Population FollowFlee::populationFromString(const QString& s)
+{
+    if (s == "fromNodes") return FromNodes;
+    if (s == "random") return RandomPopulation;
+    if (s == "fromFile") return FromFile;
+    qFatal("the population is invalid!");
+}
+
+Topology::Layout FollowFlee::cellLayoutFromString(const QString& s)
+{
+    if (s == "nodeIds") return Topology::NodeIds;
+    if (s == "zOrder") return Topology::ZOrder;
+    if (s == "rcm") return Topology::Rcm;
+    qFatal("the cell layout is invalid!");
+}
+
 } // evoplex
 REGISTER_PLUGIN(FollowFlee)
 #include "plugin.moc"
@@ -3,9 +3,20 @@
 #ifndef FOLLOWFLEE_H
 #define FOLLOWFLEE_H
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <QFile>
 #include <plugininterface.h>
 
+#include "equilibrium.h"
+#include "gridexport.h"
+#include "perfcounters.h"
+#include "snapshotwriter.h"
+#include "streamrng.h"
+#include "telemetry.h"
+#include "topology.h"
+
 namespace evoplex {
 class FollowFlee: public AbstractModel
 {
@@ -29,6 +40,19 @@ public:
      */
     bool algorithmStep() override;
 
+    /**
+     * @brief It is executed after the algorithmStep() loop; it waits for
+     * the forked branches, if any.
+     */
+    void afterLoop() override;
+
+    /**
+     * @brief Exports the model event counters and the hardware performance
+     * counters of the last generation.
+     * @param inputs the names of the counters (metadata.json)
+     */
+    Values customOutputs(const Values& inputs) const override;
+
 private:
     /**
      * The node's attributes as defined in the metadata.json
@@ -40,6 +64,47 @@ private:
      */
     enum RepMode { SimpleBD, NeighbourBD };
 
+    /**
+     * The update schemes implemented in the model (metadata.json)
+     */
+    enum UpdateScheme { RandomSequential, Synchronous, Asynchronous, Speculative };
+
+    /**
+     * The sources of the initial population (metadata.json)
+     */
+    enum Population { FromNodes, RandomPopulation, FromFile };
+
+    /**
+     * The attributes overridden by a branch forked from a running simulation
+     */
+    struct Branch {
+        RepMode repMode;
+        double repRate;
+        int stepsPerGen;
+    };
+
+    /**
+     * The logical events drawing random numbers; in the common random numbers
+     * mode, each of them has its own stream, keyed by the event itself
+     */
+    enum RandomEvent {
+        PopulationEvent,  // the initial conditions
+        OrderEvent,       // the order of the agents in a generation
+        MoveEvent,        // the steps of an agent in a generation
+        ReplacementEvent  // the birth of an offspring
+    };
+
+    /**
+     * The random numbers of one event: its own stream in the common random
+     * numbers mode, otherwise the model's PRG (ie, in the order of the draws)
+     */
+    struct EventRng {
+        PRG* prg;
+        StreamRng stream;
+        template<typename T> T uniform(T max) { return prg ? prg->uniform(max) : stream.uniform(max); }
+        int uniform(int min, int max) { return prg ? prg->uniform(min, max) : stream.uniform(min, max); }
+    };
+
     /**
      * A convenient struct used to calculate and determine the move performed by an agent.
      */
@@ -48,12 +113,216 @@ private:
         int score;
     };
 
+    /**
+     * A convenient struct used to count the code paths taken in a generation.
+     * Each worker keeps its own copy, which is merged at the end of the generation.
+     */
+    struct Counters {
+        quint64 moves = 0;         // agent-steps that changed the agent's position
+        quint64 blocked = 0;       // agent-steps without any free cell around
+        quint64 randomMoves = 0;   // agent-steps without neighbours (moved at random)
+        quint64 uniqueMax = 0;     // agent-steps with a single best free cell
+        quint64 ties = 0;          // agent-steps with a tie-break among the best free cells
+        quint64 randomActions = 0; // evaluations with the action code 3 (random)
+        quint64 fallbacks = 0;     // offspring placed by selectEmptyCell() in neighbourBD
+        quint64 memoHits = 0;      // agent-steps reused from the memo (memoSteps=true)
+        quint64 memoMisses = 0;    // agent-steps computed in full (memoSteps=true)
+        quint64 conflicts = 0;     // moves lost to another agent claiming the same cell (parallel schemes)
+        quint64 replays = 0;       // agents executed again after a failed speculation (speculative)
+
+        void merge(const Counters& c) {
+            moves += c.moves;
+            blocked += c.blocked;
+            randomMoves += c.randomMoves;
+            uniqueMax += c.uniqueMax;
+            ties += c.ties;
+            randomActions += c.randomActions;
+            fallbacks += c.fallbacks;
+            memoHits += c.memoHits;
+            memoMisses += c.memoMisses;
+            conflicts += c.conflicts;
+            replays += c.replays;
+        }
+    };
+
+    /**
+     * The signature of an horizon which cannot be packed in 64 bits
+     */
+    static const quint64 InvalidSignature = ~quint64(0);
+
+    /**
+     * The longest period (in generations) checked by the cycle detection and
+     * the number of consecutive periods required to consider the run settled
+     */
+    static const int MaxCyclePeriod = 8;
+    static const int CycleRepeats = 3;
+
+    /**
+     * The number of agents per worker speculated at once (speculative scheme)
+     */
+    static const int SpeculativeWindow = 128;
+
+    /**
+     * A convenient struct used to remember the outcome of the last deterministic
+     * step taken from a cell, ie, without any random draw.
+     */
+    struct StepMemo {
+        quint64 signature = InvalidSignature; // the horizon signature of the step
+        int payoff = 0;       // the score received in the step
+        int target = -1;      // the cell where the agent ended up
+        bool blocked = false; // true if there was no free cell around
+    };
+
+    /**
+     * Pointers to the state used by the synchronous scheme
+     */
+    struct SyncBuffers {
+        quint8* strategies;           // by cell
+        quint8* actions;              // by cell
+        std::atomic<quint64>* claims; // by cell
+        const quint64* streams;       // the random stream of each agent, by agent
+        int* cells;                   // by agent
+        int* targets;                 // by agent
+        quint64* claimKeys;           // by agent
+        int* scores;                  // by agent
+    };
+
+    /**
+     * A read-only view of the occupancy array shared by the asynchronous workers
+     */
+    struct AtomicStrategies {
+        const std::atomic<quint8>* cells;
+        int operator[](int id) const { return cells[id].load(std::memory_order_relaxed); }
+    };
+
+    /**
+     * A view of the grid as seen by a speculated agent: the grid at the
+     * beginning of the window, but with the agent moved from @p origin to @p current
+     */
+    struct OverlayStrategies {
+        const quint8* cells;
+        int origin;
+        int current;
+        quint8 strategy;
+        int operator[](int id) const {
+            return id == current ? strategy : (id == origin ? 0 : cells[id]);
+        }
+    };
+
+    /**
+     * A stand-in for the PRG used by the speculation: any draw makes the
+     * speculation useless, as the draws must happen in the sequential order
+     */
+    struct SpeculativeRng {
+        bool used = false;
+        template<typename T> T uniform(T) { used = true; return 0; }
+        int uniform(int min, int) { used = true; return min; }
+    };
+
+    /**
+     * A view of one replica in the interleaved tables of a ReplicaBatch
+     */
+    struct ReplicaStrategies {
+        const quint8* cells;
+        int numReplicas;
+        int replica;
+        int operator[](int id) const {
+            return cells[static_cast<size_t>(id) * numReplicas + replica];
+        }
+    };
+
+    /**
+     * Independent replicas of the synchronous scheme run side by side. The
+     * per-cell tables hold the replicas of each cell next to each other
+     * (cell * size + replica), so a single sweep over the neighbour table
+     * advances all of them. The replicate k replays the single run of the
+     * synchronous scheme with the seed (seed + k): it has its own copy of the
+     * model's PRG and its agents keep the order, the random streams and the
+     * claims they have in that run; so, its results are the same, in any batch.
+     */
+    struct ReplicaBatch {
+        /**
+         * The model attributes of a replica; they differ only in a sweep
+         */
+        struct Params {
+            RepMode repMode;
+            double repRate;
+            int stepsPerGen;
+            double density;
+        };
+
+        /**
+         * The running estimate of the observable of a point of the sweep
+         */
+        struct Estimate {
+            int launched = 0;  // the replicates started so far
+            int n = 0;         // the replicates finished so far
+            double sum = 0.0;
+            double sumSq = 0.0;
+            bool done = false;
+        };
+
+        int size = 0;                   // the number of replicas (0: disabled)
+        int first = 0;                  // the id of the first replica
+        int replicates = 0;             // the replicas of each point of the sweep (at least)
+        int replicateSteps = 0;         // the generations of each replicate (0: the whole run)
+        int maxReplicates = 0;          // the replicates of each point at most (0: unlimited)
+        double ciHalfWidth = 0.0;       // a point is done once its 95% CI is this narrow
+        bool ciOnMeanScore = false;     // the observable of the CI: mean score or cooperator fraction
+        std::vector<Params> pointParams; // by point
+        std::vector<Estimate> estimates; // by point
+        std::vector<Params> params;     // by replica
+        std::vector<int> points;        // the point run by each replica (-1: idle)
+        std::vector<quint64> ids;       // the replicate run by each replica
+        int generation = 0;             // the generations since the replicates started
+        std::vector<int> cells;         // the cells holding a node
+        std::vector<int> cellsById;     // the same cells, by node id
+        std::vector<int> idRanks;       // the position of each cell in cellsById, by cell
+        std::vector<quint8> strategies; // by cell * size + replica
+        std::vector<quint8> actions;    // by cell * size + replica
+        std::vector<int> scores;        // by cell * size + replica
+        std::vector<int> agents;        // the agent's position in the m_agents of its run, by cell * size + replica
+        std::vector<quint64> streams;   // the agent's random stream (see synchronousSteps()), by cell * size + replica
+        std::vector<int> targets;       // by cell * size + replica
+        std::vector<quint64> claimKeys; // by cell * size + replica
+        std::unique_ptr<std::atomic<quint64>[]> claims; // by cell * size + replica
+        std::vector<std::unique_ptr<PRG>> prgs; // the model's PRG of each replica's run, by replica
+        std::vector<quint64> crnKeys;   // the common random numbers key of each replica's run, by replica
+        std::vector<double> cooperatorFractions; // by replica
+        std::vector<double> meanScores;          // by replica
+    };
+
+    /**
+     * A random-sequential generation spread over several calls of
+     * algorithmStep() by the time budget (stepBudget>0)
+     */
+    struct Slice {
+        bool active = false;
+        size_t cursor = 0;               // the next agent in m_agents
+        bool pendingReplacement = false; // all agents are done, but not the replacement
+        Counters counters;
+        PerfCounters::Readings stepReadings;
+        qint64 stepNsecs = 0;            // the time of the steps so far
+    };
+
+    /**
+     * The outcome of the speculative execution of all steps of an agent
+     */
+    struct Speculation {
+        int target = -1;       // the final cell
+        int score = 0;         // the score received in the generation
+        int numVisited = 0;    // the number of cells visited (including the origin)
+        int blocked = 0;       // steps without any free cell around
+        int uniqueMax = 0;     // steps with a single best free cell
+        bool usedRng = false;  // true if a random draw was needed
+    };
+
     /**
      * A convenient struct used to hold the neighbourhood state of an agent.
      */
     struct Horizon {
-        std::vector<Node> cooperators;    // the cooperators around
-        std::vector<Node> defectors;      // the cooperators around
+        std::vector<int> cooperators;     // the cooperators around
+        std::vector<int> defectors;       // the defectors around
         std::vector<FreeCell> freeCells;  // the free cells around
 
         Horizon(quint32 size) {
@@ -70,16 +339,256 @@ private:
         }
     };
 
+    /**
+     * Run the agents of the sliced generation from the cursor until the time
+     * budget is exhausted; the generation ends in the call which completes it
+     * @returns the same as algorithmStep()
+     */
+    bool slicedStep();
+
+    /**
+     * Copy the grid (the first replica of a batch) to the export segment, if any
+     */
+    void exportGrid();
+
+    /**
+     * Append the grid (the first replica of a batch) to the snapshot file, if any
+     */
+    void writeSnapshot();
+
+    /**
+     * Fill @p grid with strategy * 256 + actions of each cell, by node id
+     */
+    void gridByNodeId(quint16* grid) const;
+
+    /**
+     * Write the last generation's record to the telemetry segment, if any
+     */
+    void publishTelemetry(quint64 agents, quint64 emptyCells);
+
+    /**
+     * Clear the outputs of the last generation
+     */
+    void resetOutputs();
+
+    /**
+     * The end of a generation, after the agents' steps: the mean score, the
+     * replacement and the stop criteria
+     * @returns the same as algorithmStep()
+     */
+    bool endGeneration(Counters& counters);
+
+    /**
+     * Run all the steps of a given agent in this generation
+     * (random-sequential scheme)
+     */
+    void runAgent(Node& agent, Horizon& horizon, Counters& counters);
+
     /**
      * Update the score of a given agent, also keeping track of the
      * neighbourhood state, i.e., cooperators, defectors and free cells around.
      */
     void updateScoreAndHorizon(Node& agent, Horizon& horizon) const;
 
+    /**
+     * Fill the @p horizon of the agent in the cell @p id,
+     * reading the cells' state from @p strategies (indexed by cell)
+     * @returns the score received by playing the game with all neighbours
+     */
+    template<typename Strategies>
+    int fillHorizon(int id, Horizon& horizon, const Strategies& strategies) const;
+
+    /**
+     * Run the steps of all agents with the synchronous update scheme:
+     * every agent decides from the grid as it was at the beginning of the step,
+     * conflicting moves are resolved by random priorities and then committed.
+     */
+    void synchronousSteps(Counters& counters);
+
+    /**
+     * Decide the step of the agent @p i and claim its target cell (synchronous)
+     */
+    void decideSynchronous(const SyncBuffers& b, size_t i, quint64 genKey, int step,
+                           Horizon& horizon, Counters& counters) const;
+
+    /**
+     * Move the agent @p i if it won the claim of its target cell (synchronous)
+     */
+    void commitSynchronous(const SyncBuffers& b, size_t i, Counters& counters) const;
+
+    /**
+     * Fill the points of the sweep; the @p sweep is a list of
+     * 'name=v1,v2,...' separated by ';' and each point of the grid gets
+     * m_replicas.replicates replicas (at first); the values must be within
+     * the ranges of the attributes (see metadata.json)
+     * @returns false if the sweep is invalid
+     */
+    bool parseSweep(const QString& sweep);
+
+    /**
+     * Fill m_branches; the @p branches are separated by '|' and each one
+     * is a list of 'name=value' separated by ','
+     * @returns false if the branches are invalid
+     */
+    bool parseBranches(const QString& branches);
+
+    /**
+     * Fork a child process for each branch (Linux only); the children inherit
+     * the whole state copy-on-write, so the generations before the fork are
+     * simulated only once
+     */
+    void forkBranches();
+
+    /**
+     * The life of a forked branch: apply its attributes, re-key the random
+     * numbers and run forkSteps generations, writing the observables to a CSV file
+     * @returns false if the CSV file could not be written
+     */
+    bool runBranch(size_t branch);
+
+    /**
+     * The number of chunks of parallelFor(): parallelChunks(), or 1 in a forked
+     * branch, where the chunks run inline
+     */
+    int parallelism() const;
+
+    /**
+     * The model's PRG or, in a forked branch, the branch's own PRG
+     */
+    PRG* generator() const { return m_branchPrg ? m_branchPrg.get() : prg(); }
+
+    /**
+     * Set up the replicas from the initial population (replicas>0)
+     */
+    void initReplicas();
+
+    /**
+     * The seed of the single run replayed by the @p replica: the model's seed
+     * plus the id of its replicate
+     */
+    unsigned replicaSeed(size_t replica) const;
+
+    /**
+     * Start the next replicate of the @p point in the @p replica, from the
+     * initial population; if @p point is -1, the replica is left empty
+     */
+    void startReplica(size_t replica, int point);
+
+    /**
+     * Add the outcome of the replicates which have just ended to the estimates
+     * and give the replicas to the points whose confidence interval is still too
+     * wide, the widest first (replicateSteps>0)
+     * @returns false if all points are done
+     */
+    bool finishReplicates();
+
+    /**
+     * Write the estimate of each point to the ciOutput file, if any
+     */
+    void writeEstimates() const;
+
+    /**
+     * A generation of all replicas: the synchronous steps, the replacement
+     * and the observables; the first replica is written to the nodes
+     * @returns false if the observables are stationary
+     */
+    bool replicasStep();
+
+    /**
+     * The synchronous steps of all replicas, in a single sweep over the cells
+     */
+    void replicaSteps(Counters& counters);
+
+    /**
+     * The replacement phase of the @p replica, on the interleaved tables
+     */
+    void replicaReplacement(int replica, quint32 agentsToReplace, Counters& counters);
+
+    /**
+     * Write the state of the first replica to the nodes
+     */
+    void writeFirstReplica();
+
+    /**
+     * Run the steps of all agents with the asynchronous update scheme:
+     * the shuffled agents are split in contiguous chunks, one per worker,
+     * and each worker runs its agents as in the random-sequential scheme.
+     * Moves claim the target cell with a CAS on a shared occupancy array
+     * and a failed claim is decided again from the updated horizon.
+     *
+     * Semantic drift w.r.t. the random-sequential scheme: agents of different
+     * chunks run at the same time instead of one after the other, so an agent
+     * may see a neighbour halfway through its steps, or briefly in both the
+     * old and the new cell. The outcome depends on the thread timing, ie,
+     * runs are not reproducible, but each agent still sees a consistent
+     * occupancy (no cell is ever taken twice).
+     */
+    void asynchronousSteps(Counters& counters);
+
+    /**
+     * Run the steps of all agents with the speculative update scheme, which
+     * gives exactly the same results as the random-sequential scheme.
+     * The shuffled agents are processed in windows: all agents of a window
+     * are speculated in parallel against the grid at the beginning of the
+     * window, then validated and committed in the sequential order. Agents
+     * which need random draws, or whose horizon was changed by an earlier
+     * agent of the window, are executed again (sequentially).
+     */
+    void speculativeSteps(Counters& counters);
+
+    /**
+     * Speculate all the steps of the agent in the cell @p origin without
+     * changing the grid; @p visited receives the cells visited by the agent
+     */
+    void speculate(int origin, Horizon& horizon, Speculation& spec, int* visited) const;
+
+    /**
+     * Mark the cell @p id and the cells having it in their horizon as
+     * changed in the current window (speculative)
+     */
+    void markDirty(int id);
+
+    /**
+     * Write the agents' new positions and scores back to the nodes and
+     * rebuild the vacancy counters, the empty cells and the state hash
+     * (the strategy/actions mirrors must be up to date)
+     */
+    void writeBack(const std::vector<int>& origins, const std::vector<int>& cells,
+                   const std::vector<int>& scores, int numChunks);
+
+    /**
+     * Perform one step of a given agent, reusing the outcome of the last
+     * deterministic step taken from the same cell and horizon, if any
+     */
+    void memoisedStep(Node& agent, Horizon& horizon, EventRng& rng, Counters& counters);
+
+    /**
+     * Pack the agent's strategy and actions and the strategy of each
+     * neighbour (2 bits per slot) in a single word
+     * @returns InvalidSignature if the agent has more than 24 neighbours
+     */
+    quint64 horizonSignature(const Node& agent) const;
+
     /**
      * Update the position of a given agent based on its neighbourhood state (horizon)
      */
-    void updatePosition(Node& agent, Horizon& horizon);
+    void updatePosition(Node& agent, Horizon& horizon, EventRng& rng, Counters& counters);
+
+    /**
+     * Choose where the agent in the cell @p id goes based on its horizon and actions
+     * @returns the id of the target cell (@p id itself when it stays)
+     */
+    template<typename Rng>
+    int chooseTarget(int id, quint8 actionBits, Horizon& horizon, Rng& rng,
+                     Counters& counters) const;
+
+    /**
+     * Pick the free cell with the highest score (ties are broken at random)
+     * @returns the position of the chosen cell in @p freeCells
+     */
+    template<typename Rng>
+    size_t pickHighestScore(const std::vector<FreeCell>& freeCells, Rng& rng,
+                            Counters& counters) const;
 
     /**
      * Replacement strategy: replace the worst X agents by the best X agents
@@ -90,7 +599,7 @@ private:
      * Replacement strategy: replace the worst X agents by the best X agents
      * but trying to keep the offspring in the parent neighbourhood
      */
-    void neighbourBD(quint32 agentsToReplace);
+    void neighbourBD(quint32 agentsToReplace, Counters& counters);
 
     /**
      * Play the prisoner's dilemma game
@@ -98,30 +607,94 @@ private:
     int playGame(int strA, int strB) const;
 
     /**
-     * Move the @p agent to the @p targetId
+     * Move the @p agent to the cell @p target
+     */
+    void move(Node& agent, int target, Counters& counters);
+
+    /**
+     * The cell of the @p node in the internal layout
+     */
+    int cellOf(const Node& node) const { return m_topology->cell(node.id()); }
+
+    /**
+     * The node in the @p cell of the internal layout
      */
-    void move(Node& agent, int targetId);
+    Node nodeAt(int cell) const { return node(m_topology->nodeId(cell)); }
 
     /**
      * Choose an empty cell at random
      */
-    Node selectEmptyCell() const;
+    Node selectEmptyCell(EventRng& rng) const;
+
+    /**
+     * The random numbers of the event @p event at node @p id in this generation
+     */
+    EventRng eventRng(RandomEvent event, int id);
+
+    /**
+     * The same, for a run (eg, a replica) whose PRG is @p prg, whose common random
+     * numbers key is @p crnKey and which is in the generation @p generation
+     */
+    EventRng eventRng(PRG* prg, quint64 crnKey, int generation, RandomEvent event, int id) const;
+
+    /**
+     * A key for the per-event streams of a generation; it is drawn from the
+     * model's PRG, or derived from @p event in the common random numbers mode
+     */
+    quint64 generationKey(RandomEvent event);
+
+    /**
+     * The same, for a run (eg, a replica); see eventRng()
+     */
+    quint64 generationKey(PRG* prg, quint64 crnKey, int generation, RandomEvent event) const;
+
+    /**
+     * Shuffle m_agents; in the common random numbers mode, the agents are ordered
+     * by a random priority keyed by their node, so the agents present in two runs
+     * keep their relative order
+     */
+    void shuffleAgents();
 
     /**
      * Copy attributes from the agent @p src to the agent @p tgt
      */
-    void copyAttrs(Node& src, Node& tgt) const;
+    void copyAttrs(Node& src, Node& tgt);
 
     /**
      * Sets all the agent's attrs to zero
      */
     void clearAttrs(Node& agent);
 
+    /**
+     * Keep the strategy mirror and the vacancy counters in sync
+     * with the strategy of the cell @p id
+     */
+    void setStrategy(int id, quint8 strategy);
+
+    /**
+     * The Zobrist key of the cell @p id holding the given strategy and actions
+     */
+    static quint64 cellKey(int id, int strategy, int actions);
+
+    /**
+     * Look for a repetition of the grid state in the last generations
+     * @returns true if the state has been repeating with the same period
+     * for at least CycleRepeats periods
+     */
+    bool detectCycle();
+
+    /**
+     * The score received by playing the game with all neighbours once
+     */
+    int payoff(int id) const;
+
     /**
      * Evaluate the free cells in the neighbourhood
      */
+    template<typename Rng>
     void evalFreeCells(std::vector<FreeCell>& freeCells,
-            const std::vector<Node>& neighbours, quint8 action) const;
+            const std::vector<int>& neighbours, quint8 action,
+            Rng& rng, Counters& counters) const;
 
     /**
      * The center cell (0) sums zero and the others subtract one
@@ -131,36 +704,160 @@ private:
     /**
      * The intersecting neighbours sum one and the others sum zero
      */
-    void follow(std::vector<FreeCell>& freeCells, const Node& neighbour) const;
+    void follow(std::vector<FreeCell>& freeCells, int neighbourId) const;
 
     /**
      * The intersecting neighbours sum zero and the others sum one
      */
-    void flee(std::vector<FreeCell>& freeCells, const Node& neighbour) const;
+    void flee(std::vector<FreeCell>& freeCells, int neighbourId) const;
 
     /**
      * All neighbours sum randomly (ie, -1, 0 or +1 for each neighbour)
      */
-    void random(std::vector<FreeCell>& freeCells, int numNeighbours) const;
+    template<typename Rng>
+    void random(std::vector<FreeCell>& freeCells, int numNeighbours, Rng& rng) const;
 
     /**
      * Sort a vector of agents by score (descending)
      */
-    void sortAgentsByScore(std::vector<Node> agents) const;
+    void sortAgentsByScore(std::vector<Node>& agents) const;
+
+    /**
+     * Returns the hardware counter @p event of the given phase divided by @p divisor,
+     * or -1 if the counter is not available or if the phase also ran on other threads
+     * (the counters only follow the calling thread).
+     */
+    Value perfOutput(const PerfCounters::Readings& readings,
+                     PerfCounters::Event event, quint64 divisor) const;
+
+    /**
+     * An auxiliary function to convert a string to RepMode; an invalid
+     * string is fatal, unless @p ok is given (then it is set to false)
+     */
+    RepMode repModeFromString(const QString& s, bool* ok = nullptr);
+
+    /**
+     * An auxiliary function to convert a string to UpdateScheme
+     */
+    UpdateScheme updateSchemeFromString(const QString& s);
+
+    /**
+     * Fill the state of all cells (and nodes) from the random sampler or the
+     * population file; it runs in parallel and does not depend on the threads
+     */
+    void createPopulation();
+
+    /**
+     * Draw the strategy and actions of a cell of a random population
+     */
+    void sampleCell(StreamRng& rng, double density, quint8& strategy, quint8& actions) const;
+
+    /**
+     * Draw the strategy and actions of the node @p nodeId of a created population
+     * (random or from a file), from its stream keyed by @p populationKey
+     */
+    void initialCell(quint64 populationKey, int nodeId, double density,
+                     quint8& strategy, quint8& actions) const;
+
+    /**
+     * Draw an action genome; each bit is set with m_actionBitProbability
+     */
+    quint8 randomActions(StreamRng& rng) const;
+
+    /**
+     * Read the initial grid from a binary PGM (P5) file into m_initialGrid
+     * @returns false if the file is missing or does not match the graph
+     */
+    bool loadInitialGrid(const QString& path);
+
+    /**
+     * Take m_topology from the experiments of this process running on the same
+     * graph or build it; for graphs read from an edges file and if enabled, it is
+     * mapped from the binary cache (which is created on the first run)
+     */
+    void buildTopology(int width);
+
+    /**
+     * An auxiliary function to convert a string to Population
+     */
+    Population populationFromString(const QString& s);
 
     /**
-     * An auxiliary function to convert a string to RepMode
+     * An auxiliary function to convert a string to Topology::Layout
      */
-    RepMode repModeFromString(const QString& s);
+    Topology::Layout cellLayoutFromString(const QString& s);
 
     // the model attributes (as defined in the metadata.json)
     RepMode m_repMode;  // replacement mode
     double m_repRate;   // replacement rate
     int m_stepsPerGen;
+    UpdateScheme m_updateScheme;
+    int m_stepBudget;   // the time (ms) of a call to algorithmStep() at most (0: a whole generation)
+    Slice m_slice;      // the generation in progress (stepBudget>0)
+    Topology::Layout m_cellLayout; // the order of the cells in the per-cell tables
+    bool m_adjacencyCache; // keep a binary copy of the adjacency next to the edges file
+    Population m_population;        // the source of the initial population
+    double m_density;               // the fraction of occupied cells (random population)
+    double m_initialCooperators;    // the fraction of cooperators (random population)
+    double m_actionBitProbability;  // the probability of each bit of the action genomes
+    std::vector<quint16> m_initialGrid; // strategy * 256 + actions, by node id (population file)
+    bool m_commonRandomNumbers;     // key the random streams by event instead of draw order
+    quint64 m_crnKey;               // the root of the per-event streams
+    bool m_initialGridHasActions = false; // false for 8-bit files (only strategies)
+    bool m_memoSteps;   // reuse the outcome of deterministic steps
+    bool m_stopOnCycle; // stop when the grid state settles in a fixed point or short cycle
 
     std::vector<Node> m_agents; // the cells with live agents, ie, strategy=[1,2]
-    std::map<int, Node> m_emptyCells; // the empty cells
+    std::map<int, Node> m_emptyCells; // the empty cells, by node id
+
+    std::shared_ptr<const Topology> m_topology; // a compact copy of the graph's adjacency (shared)
+    std::vector<quint8> m_strategies; // a mirror of the cells' strategy, by cell
+    std::vector<quint8> m_actions;    // a mirror of the cells' actions, by cell
+    std::vector<quint16> m_vacantNeighbours; // the number of empty neighbours, by cell
+    std::vector<StepMemo> m_memo; // the last deterministic step, by cell (memoSteps=true)
+    std::unique_ptr<std::atomic<quint64>[]> m_claims; // the target cells' claims, by cell (synchronous)
+    std::unique_ptr<std::atomic<quint8>[]> m_occupancy; // the cells' strategy, by cell (asynchronous)
+    std::vector<quint32> m_dirty; // the last window which changed a cell's horizon, by cell (speculative)
+    quint32 m_dirtyStamp = 0;     // the current window (speculative)
+    ReplicaBatch m_replicas;      // the replicas run side by side (replicas>0)
+    std::unique_ptr<QFile> m_sweepOutput; // the results of each replica, by generation
+    QString m_ciOutput;           // the estimate of each point, rewritten after each round of replicates
+    int m_pendingPoints = 0;      // the points whose confidence interval is still too wide
+
+    int m_generation = 0;         // the generations started so far
+    int m_forkAt;                 // the generation at which the branches are forked (0: never)
+    int m_forkSteps;              // the generations run by each branch
+    QString m_forkOutput;         // the prefix of the branches' CSV files
+    std::vector<Branch> m_branches;
+    std::vector<qint64> m_branchPids;  // the forked branches still running
+    std::unique_ptr<PRG> m_branchPrg;  // the re-keyed PRG (forked branches only)
+    bool m_inBranch = false;           // a forked branch, which must not use the thread pool
+
+    GridExport m_gridExport;      // the grid shared with external viewers (gridExport)
+    Telemetry m_telemetry;        // the health of the run, for external monitors (telemetry)
+    SnapshotWriter m_snapshots;   // the grid of each generation (snapshotOutput)
+    std::vector<quint16> m_snapshotGrid;
+    qint64 m_stepNsecs = 0;       // the time of the steps phase of the last generation
+    qint64 m_replacementNsecs = 0; // the time of the replacement phase of the last generation
+
+    quint64 m_stateHash = 0; // Zobrist hash of the strategy and actions of all cells
+    std::vector<quint64> m_hashHistory; // the state hash at the end of each generation
+    int m_cyclePeriod = 0; // the period of the detected cycle (1 for fixed points), if any
+    int m_cycleRun = 0;    // generations in a row repeating the candidate period
+
+    double m_cooperatorFraction = 0.0; // cooperators/agents at the end of the last generation
+    double m_meanScore = 0.0;          // the agents' mean score in the last generation
+    double m_cooperatorFractionStdDev = 0.0; // the spread of the above across the replicas
+    double m_meanScoreStdDev = 0.0;
+    EquilibriumDetector m_equilibrium; // stops the run once the observables above settle
+
+    Counters m_counters; // the event counters of the last generation
 
+    // hardware performance counters (perfCounters=true) of the last generation
+    std::unique_ptr<PerfCounters> m_perf;
+    PerfCounters::Readings m_stepReadings; // steps taken by the agents
+    PerfCounters::Readings m_repReadings;  // replacement phase
+    quint64 m_agentSteps = 0;
 
 };
 } // evoplex
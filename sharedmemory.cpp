@@ -0,0 +1,69 @@
+// Evoplex <https://evoplex.org>
+
+#include <cstring>
+
+#include "sharedmemory.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define FOLLOWFLEE_HAS_MMAP
+#endif
+
+namespace evoplex {
+
+SharedMemory::~SharedMemory()
+{
+    release();
+}
+
+bool SharedMemory::createNamed(const QString& name, size_t size)
+{
+    release();
+#ifdef FOLLOWFLEE_HAS_MMAP
+    const QByteArray path = name.toLocal8Bit();
+    const int fd = shm_open(path.constData(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        shm_unlink(path.constData());
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (data == MAP_FAILED) {
+        shm_unlink(path.constData());
+        return false;
+    }
+    m_data = data;
+    m_size = size;
+    m_name = path;
+    m_owner = getpid();
+    return true;
+#else
+    (void) name;
+    (void) size;
+    return false;
+#endif
+}
+
+void SharedMemory::release()
+{
+#ifdef FOLLOWFLEE_HAS_MMAP
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    if (!m_name.isEmpty() && m_owner == getpid()) {
+        shm_unlink(m_name.constData());
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_name.clear();
+    m_owner = 0;
+}
+
+} // evoplex
@@ -0,0 +1,50 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_SHAREDMEMORY_H
+#define FOLLOWFLEE_SHAREDMEMORY_H
+
+#include <cstddef>
+#include <plugininterface.h>
+
+namespace evoplex {
+
+/**
+ * A named memory segment shared with any process opening the same name
+ * (and with the child processes created by fork()).
+ * It is only available on POSIX systems; elsewhere create() fails and the
+ * callers are expected to fall back to their in-process code path.
+ */
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    /**
+     * @brief Maps the named segment @p name (eg, "/name") of @p size bytes,
+     * creating it if needed; other processes can map it with shm_open().
+     * @returns false if the segment could not be created
+     */
+    bool createNamed(const QString& name, size_t size);
+
+    /**
+     * @brief Unmaps the segment; a named segment is also unlinked, but only
+     * by the process which created it (not by its forked children).
+     */
+    void release();
+
+    void* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+    QByteArray m_name; // named segments only
+    qint64 m_owner = 0; // the process which created the named segment
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_SHAREDMEMORY_H
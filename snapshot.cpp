@@ -0,0 +1,239 @@
+// Evoplex <https://evoplex.org>
+
+#include <algorithm>
+#include <cstring>
+
+#include "snapshot.h"
+
+namespace evoplex {
+
+static inline int popCount(quint64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    int count = 0;
+    for (; x; x &= x - 1) ++count;
+    return count;
+#endif
+}
+
+static inline int countTrailingZeros(quint64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int count = 0;
+    for (; !(x & 1); x >>= 1) ++count;
+    return count;
+#endif
+}
+
+void Snapshot::splitPlanes(const quint16* grid, quint32 numSlots, quint64* planes)
+{
+    const size_t words = numWords(numSlots);
+    std::memset(planes, 0, NumPlanes * words * sizeof(quint64));
+    for (quint32 i = 0; i < numSlots; ++i) {
+        const quint32 strategy = grid[i] >> 8;
+        const quint32 actions = grid[i] & 0xFF;
+        const size_t w = i / 64;
+        const quint64 bit = quint64(1) << (i % 64);
+        if (strategy == 0) {
+            continue; // an empty cell
+        }
+        planes[Occupancy * words + w] |= bit;
+        if (strategy == 2) planes[Defector * words + w] |= bit;
+        for (int a = 0; a < 8; ++a) {
+            if ((actions >> a) & 1) planes[(FirstAction + a) * words + w] |= bit;
+        }
+    }
+}
+
+void Snapshot::mergePlanes(const quint64* planes, quint32 numSlots, quint16* grid)
+{
+    const size_t words = numWords(numSlots);
+    for (quint32 i = 0; i < numSlots; ++i) {
+        const size_t w = i / 64;
+        const int shift = i % 64;
+        auto bit = [&](int plane) { return static_cast<quint32>((planes[plane * words + w] >> shift) & 1); };
+        const quint32 strategy = bit(Occupancy) ? 1 + bit(Defector) : 0;
+        quint32 actions = 0;
+        for (int a = 0; a < 8; ++a) {
+            actions |= bit(FirstAction + a) << a;
+        }
+        grid[i] = static_cast<quint16>((strategy << 8) | actions);
+    }
+}
+
+void Snapshot::encodeFrame(const quint64* planes, const quint64* previous, quint32 numSlots,
+                           FrameHeader& header, std::vector<char>& out)
+{
+    const size_t words = numWords(numSlots);
+    std::vector<quint64> coded(words), packed(words);
+    header.keyframe = previous == nullptr;
+    header.plainPlanes = 0;
+    for (int p = 0; p < NumPlanes; ++p) {
+        const quint64* plane = planes + p * words;
+        for (size_t w = 0; w < words; ++w) {
+            coded[w] = previous ? plane[w] ^ previous[p * words + w] : plane[w];
+        }
+
+        const size_t before = out.size();
+        bool plain;
+        if (p == Occupancy) {
+            plain = encodePlane(coded.data(), numSlots, out);
+        } else {
+            const size_t numBits = packPlane(coded.data(), planes, words, packed.data());
+            plain = encodePlane(packed.data(), numBits, out);
+        }
+        header.planeBytes[p] = static_cast<quint32>(out.size() - before);
+        header.plainPlanes |= static_cast<quint32>(plain) << p;
+    }
+}
+
+bool Snapshot::decodeFrame(const FrameHeader& header, const char* data, quint32 numSlots,
+                           quint64* planes)
+{
+    const size_t words = numWords(numSlots);
+    std::vector<quint64> decoded(words), unpacked(words);
+    size_t numBits = numSlots;
+    for (int p = 0; p < NumPlanes; ++p) {
+        quint64* plane = planes + p * words;
+        const bool plain = (header.plainPlanes >> p) & 1;
+        if (!decodePlane(data, header.planeBytes[p], numBits, plain, decoded.data())) {
+            return false;
+        }
+        data += header.planeBytes[p];
+
+        if (p == Occupancy) {
+            for (size_t w = 0; w < words; ++w) {
+                plane[w] = header.keyframe ? decoded[w] : plane[w] ^ decoded[w];
+            }
+            numBits = 0;
+            for (size_t w = 0; w < words; ++w) {
+                numBits += static_cast<size_t>(popCount(plane[w]));
+            }
+        } else {
+            // the bits of the cells which became empty are dropped
+            unpackPlane(decoded.data(), planes, words, unpacked.data());
+            for (size_t w = 0; w < words; ++w) {
+                plane[w] = header.keyframe ? unpacked[w] : (plane[w] & planes[w]) ^ unpacked[w];
+            }
+        }
+    }
+    return true;
+}
+
+size_t Snapshot::packPlane(const quint64* words, const quint64* mask, size_t numWords, quint64* packed)
+{
+    size_t n = 0;
+    std::memset(packed, 0, numWords * sizeof(quint64));
+    for (size_t w = 0; w < numWords; ++w) {
+        for (quint64 m = mask[w]; m; m &= m - 1, ++n) {
+            packed[n / 64] |= ((words[w] >> countTrailingZeros(m)) & 1) << (n % 64);
+        }
+    }
+    return n;
+}
+
+void Snapshot::unpackPlane(const quint64* packed, const quint64* mask, size_t numWords, quint64* words)
+{
+    size_t n = 0;
+    for (size_t w = 0; w < numWords; ++w) {
+        words[w] = 0;
+        for (quint64 m = mask[w]; m; m &= m - 1, ++n) {
+            words[w] |= ((packed[n / 64] >> (n % 64)) & 1) << countTrailingZeros(m);
+        }
+    }
+}
+
+bool Snapshot::encodePlane(const quint64* words, size_t numBits, std::vector<char>& out)
+{
+    const size_t begin = out.size();
+    const size_t plainBytes = (numBits + 7) / 8;
+    size_t pos = 0;
+    quint64 value = 0; // the bits of the current run, all 0s or all 1s
+    while (pos < numBits) {
+        // the next bit which differs from the current run
+        size_t next = numBits;
+        for (size_t w = pos / 64; w * 64 < numBits; ++w) {
+            quint64 diff = words[w] ^ value;
+            if (w == pos / 64) {
+                diff &= ~quint64(0) << (pos % 64);
+            }
+            if (diff) {
+                next = std::min(numBits, w * 64 + countTrailingZeros(diff));
+                break;
+            }
+        }
+
+        // LEB128
+        quint64 run = next - pos;
+        do {
+            const char byte = static_cast<char>(run & 0x7F);
+            run >>= 7;
+            out.push_back(run ? static_cast<char>(byte | 0x80) : byte);
+        } while (run);
+
+        pos = next;
+        value = ~value;
+
+        // too many short runs (eg, random bits)
+        if (out.size() - begin > plainBytes) {
+            out.resize(begin);
+            for (size_t i = 0; i < plainBytes; ++i) {
+                out.push_back(static_cast<char>(words[i / 8] >> (8 * (i % 8))));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Snapshot::decodePlane(const char* data, size_t size, size_t numBits, bool plain, quint64* words)
+{
+    std::memset(words, 0, ((numBits + 63) / 64) * sizeof(quint64));
+    if (plain) {
+        if (size != (numBits + 7) / 8) {
+            return false;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            words[i / 8] |= quint64(static_cast<quint8>(data[i])) << (8 * (i % 8));
+        }
+        return true;
+    }
+
+    size_t pos = 0, i = 0;
+    bool ones = false;
+    while (pos < numBits) {
+        quint64 run = 0;
+        int shift = 0;
+        quint8 byte;
+        do {
+            if (i >= size || shift > 63) {
+                return false;
+            }
+            byte = static_cast<quint8>(data[i++]);
+            run |= quint64(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        if (run > numBits - pos) {
+            return false;
+        }
+
+        if (ones) {
+            for (size_t end = pos + run; pos < end; ) {
+                const size_t n = std::min<size_t>(end - pos, 64 - pos % 64);
+                const quint64 mask = n == 64 ? ~quint64(0) : ((quint64(1) << n) - 1);
+                words[pos / 64] |= mask << (pos % 64);
+                pos += n;
+            }
+        } else {
+            pos += run;
+        }
+        ones = !ones;
+    }
+    return i == size;
+}
+
+} // evoplex
@@ -0,0 +1,105 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_SNAPSHOT_H
+#define FOLLOWFLEE_SNAPSHOT_H
+
+#include <vector>
+#include <plugininterface.h>
+
+namespace evoplex {
+
+/**
+ * The format of the grid snapshots (snapshotOutput), shared by the
+ * SnapshotWriter and the SnapshotReader.
+ *
+ * Each grid (strategy * 256 + actions, by node id) is split into bit-planes:
+ * the occupancy, the strategy (set for defectors) and the 8 action bits.
+ * The empty cells have no strategy nor actions; so, all but the occupancy
+ * plane only hold the bits of the occupied cells (by node id).
+ * A keyframe stores the planes; the other frames store their XOR with the
+ * previous frame (whose empty cells count as 0s), so the cells which did not
+ * change cost nothing. Each plane is coded as the lengths of its alternating
+ * runs of 0s and 1s (starting with 0s), as LEB128 varints, or stored as plain
+ * bits when that is shorter (eg, the action bits of a random population).
+ *
+ * The file is a FileHeader followed by the frames (a FrameHeader and the
+ * coded planes) and, once the writer is closed, the index of the frames and
+ * an IndexFooter. Without the index (eg, the run was killed), the frames can
+ * still be found by walking their headers.
+ */
+class Snapshot
+{
+public:
+    static const quint64 Magic = 0x50414e5345454646ULL;      // "FFEESNAP"
+    static const quint64 IndexMagic = 0x5844495345454646ULL; // "FFEESIDX"
+    static const quint32 Version = 1;
+
+    enum Plane { Occupancy, Defector, FirstAction, NumPlanes = FirstAction + 8 };
+
+    struct FileHeader {
+        quint64 magic;
+        quint32 version;
+        quint32 numSlots;
+        quint32 width;            // the grid's width, if any (0 otherwise)
+        quint32 keyframeInterval;
+    };
+
+    struct FrameHeader {
+        quint64 generation;
+        quint32 keyframe;         // 1: the planes are not relative to the previous frame
+        quint32 planeBytes[NumPlanes];
+        quint32 plainPlanes;      // the planes stored as plain bits (bit p for the plane p)
+    };
+
+    struct IndexEntry {
+        quint64 generation;
+        quint64 offset;           // of the FrameHeader
+    };
+
+    struct IndexFooter {
+        quint64 numFrames;
+        quint64 magic;
+    };
+
+    /**
+     * @brief The 64-bit words of a plane of @p numSlots bits.
+     */
+    static size_t numWords(quint32 numSlots) { return (numSlots + 63) / 64; }
+
+    /**
+     * @brief Splits @p grid into NumPlanes consecutive planes of numWords() words.
+     */
+    static void splitPlanes(const quint16* grid, quint32 numSlots, quint64* planes);
+
+    /**
+     * @brief The inverse of splitPlanes().
+     */
+    static void mergePlanes(const quint64* planes, quint32 numSlots, quint16* grid);
+
+    /**
+     * @brief Codes the @p planes of a frame into @p out and fills the plane
+     * fields of @p header; it is a keyframe if @p previous is null.
+     */
+    static void encodeFrame(const quint64* planes, const quint64* previous, quint32 numSlots,
+                            FrameHeader& header, std::vector<char>& out);
+
+    /**
+     * @brief The inverse of encodeFrame(); @p planes holds the previous frame
+     * (unless @p header is a keyframe) and is replaced by the decoded one.
+     * @returns false if @p data is not a frame of @p numSlots slots
+     */
+    static bool decodeFrame(const FrameHeader& header, const char* data, quint32 numSlots,
+                            quint64* planes);
+
+private:
+    // the run lengths or the plain bits of the first @p numBits bits of @p words
+    static bool encodePlane(const quint64* words, size_t numBits, std::vector<char>& out);
+    static bool decodePlane(const char* data, size_t size, size_t numBits, bool plain, quint64* words);
+
+    // the bits of @p words at the set bits of @p mask, packed together; and back
+    static size_t packPlane(const quint64* words, const quint64* mask, size_t numWords, quint64* packed);
+    static void unpackPlane(const quint64* packed, const quint64* mask, size_t numWords, quint64* words);
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_SNAPSHOT_H
@@ -0,0 +1,127 @@
+// Evoplex <https://evoplex.org>
+
+#include <algorithm>
+#include <cstring>
+
+#include "snapshotreader.h"
+
+namespace evoplex {
+
+bool SnapshotReader::open(const QString& path)
+{
+    m_frames.clear();
+    m_decoded = -1;
+    if (!m_file.open(path) || m_file.size() < sizeof(Snapshot::FileHeader)) {
+        return false;
+    }
+    std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+    if (m_header.magic != Snapshot::Magic || m_header.version != Snapshot::Version) {
+        m_file.close();
+        return false;
+    }
+    const size_t size = m_file.size();
+    const size_t words = Snapshot::numWords(m_header.numSlots);
+    m_planes.assign(Snapshot::NumPlanes * words, 0);
+
+    // the index written by the writer at the end...
+    Snapshot::IndexFooter footer;
+    if (size >= sizeof(Snapshot::FileHeader) + sizeof(footer)) {
+        std::memcpy(&footer, m_file.data() + size - sizeof(footer), sizeof(footer));
+        const size_t maxFrames = (size - sizeof(Snapshot::FileHeader) - sizeof(footer))
+                / sizeof(Snapshot::IndexEntry);
+        if (footer.magic == Snapshot::IndexMagic && footer.numFrames <= maxFrames) {
+            const size_t indexBytes = footer.numFrames * sizeof(Snapshot::IndexEntry);
+            m_frames.resize(footer.numFrames);
+            std::memcpy(m_frames.data(), m_file.data() + size - sizeof(footer) - indexBytes, indexBytes);
+            return true;
+        }
+    }
+
+    // ... or, if the run did not finish, the frames found by walking their headers
+    size_t offset = sizeof(Snapshot::FileHeader);
+    while (size - offset >= sizeof(Snapshot::FrameHeader)) {
+        Snapshot::FrameHeader header;
+        std::memcpy(&header, m_file.data() + offset, sizeof(header));
+        size_t frameBytes = sizeof(header);
+        for (quint32 bytes : header.planeBytes) {
+            frameBytes += bytes;
+        }
+        if (frameBytes > size - offset) {
+            break; // a partial frame
+        }
+        m_frames.push_back({header.generation, offset});
+        offset += frameBytes;
+    }
+    return true;
+}
+
+int SnapshotReader::find(quint64 generation) const
+{
+    auto it = std::lower_bound(m_frames.begin(), m_frames.end(), generation,
+        [](const Snapshot::IndexEntry& e, quint64 g) { return e.generation < g; });
+    return it != m_frames.end() && it->generation == generation
+            ? static_cast<int>(it - m_frames.begin()) : -1;
+}
+
+Snapshot::FrameHeader SnapshotReader::frameHeader(size_t frame) const
+{
+    Snapshot::FrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (m_frames[frame].offset + sizeof(header) <= m_file.size()) {
+        std::memcpy(&header, m_file.data() + m_frames[frame].offset, sizeof(header));
+    }
+    return header;
+}
+
+bool SnapshotReader::read(size_t frame, std::vector<quint16>& grid)
+{
+    if (frame >= m_frames.size()) {
+        return false;
+    }
+
+    // the nearest keyframe, unless the last decoded frame is closer
+    size_t first = frame;
+    const size_t next = static_cast<size_t>(m_decoded + 1);
+    if (static_cast<int>(frame) != m_decoded) {
+        while (first != next && !frameHeader(first).keyframe) {
+            if (first == 0) {
+                return false; // no keyframe before it
+            }
+            --first;
+        }
+    }
+
+    for (size_t f = first; f <= frame; ++f) {
+        if (!decodeFrame(f)) {
+            m_decoded = -1;
+            return false;
+        }
+    }
+
+    grid.resize(m_header.numSlots);
+    Snapshot::mergePlanes(m_planes.data(), m_header.numSlots, grid.data());
+    return true;
+}
+
+bool SnapshotReader::decodeFrame(size_t frame)
+{
+    if (frame == static_cast<size_t>(m_decoded)) {
+        return true;
+    }
+    const Snapshot::FrameHeader header = frameHeader(frame);
+    size_t frameBytes = sizeof(header);
+    for (quint32 bytes : header.planeBytes) {
+        frameBytes += bytes;
+    }
+    if (m_frames[frame].offset + frameBytes > m_file.size()) {
+        return false;
+    }
+    const char* data = m_file.data() + m_frames[frame].offset + sizeof(header);
+    if (!Snapshot::decodeFrame(header, data, m_header.numSlots, m_planes.data())) {
+        return false;
+    }
+    m_decoded = static_cast<int>(frame);
+    return true;
+}
+
+} // evoplex
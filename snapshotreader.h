@@ -0,0 +1,57 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_SNAPSHOTREADER_H
+#define FOLLOWFLEE_SNAPSHOTREADER_H
+
+#include <vector>
+#include <plugininterface.h>
+
+#include "mappedfile.h"
+#include "snapshot.h"
+
+namespace evoplex {
+
+/**
+ * Random access to the grids of a snapshot file (see Snapshot). A grid is
+ * decoded from the nearest keyframe before it or, when reading forwards,
+ * from the last grid read.
+ */
+class SnapshotReader
+{
+public:
+    /**
+     * @brief Maps the snapshot file at @p path.
+     * @returns false if the file could not be read or is not a snapshot file
+     */
+    bool open(const QString& path);
+
+    quint32 numSlots() const { return m_header.numSlots; }
+    quint32 width() const { return m_header.width; }
+    size_t numFrames() const { return m_frames.size(); }
+    quint64 generation(size_t frame) const { return m_frames[frame].generation; }
+
+    /**
+     * @brief The frame of the generation @p generation, or -1 if there is none.
+     */
+    int find(quint64 generation) const;
+
+    /**
+     * @brief Decodes the grid of @p frame (strategy * 256 + actions, by node id).
+     * @returns false if the file is corrupted
+     */
+    bool read(size_t frame, std::vector<quint16>& grid);
+
+private:
+    MappedFile m_file;
+    Snapshot::FileHeader m_header;
+    std::vector<Snapshot::IndexEntry> m_frames;
+    std::vector<quint64> m_planes;  // of the frame m_decoded
+    int m_decoded = -1;
+
+    // a copy, as the frames are not aligned
+    Snapshot::FrameHeader frameHeader(size_t frame) const;
+    bool decodeFrame(size_t frame);
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_SNAPSHOTREADER_H
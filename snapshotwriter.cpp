@@ -0,0 +1,108 @@
+// Evoplex <https://evoplex.org>
+
+#include <algorithm>
+#include <cstring>
+
+#include "snapshotwriter.h"
+
+namespace evoplex {
+
+bool SnapshotWriter::open(const QString& path, quint32 numSlots, quint32 width, quint32 keyframeInterval)
+{
+    close();
+    m_file.reset(new QFile(path));
+    if (!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_file.reset();
+        return false;
+    }
+
+    m_numSlots = numSlots;
+    m_keyframeInterval = std::max<quint32>(1, keyframeInterval);
+    m_offset = 0;
+    m_index.clear();
+    m_planes.assign(Snapshot::NumPlanes * Snapshot::numWords(numSlots), 0);
+    m_previous.assign(m_planes.size(), 0);
+
+    Snapshot::FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = Snapshot::Magic;
+    header.version = Snapshot::Version;
+    header.numSlots = numSlots;
+    header.width = width;
+    header.keyframeInterval = m_keyframeInterval;
+    if (!writeBytes(&header, sizeof(header))) {
+        m_file.reset();
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotWriter::write(quint64 generation, const quint16* grid)
+{
+    if (!m_file) {
+        return false;
+    }
+
+    m_planes.swap(m_previous);
+    Snapshot::splitPlanes(grid, m_numSlots, m_planes.data());
+
+    Snapshot::FrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.generation = generation;
+
+    // the delta frames code the bits which changed since the previous frame
+    const bool keyframe = m_index.size() % m_keyframeInterval == 0;
+    m_buffer.clear();
+    Snapshot::encodeFrame(m_planes.data(), keyframe ? nullptr : m_previous.data(),
+                          m_numSlots, header, m_buffer);
+
+    const quint64 offset = m_offset;
+    if (!writeBytes(&header, sizeof(header)) || !writeBytes(m_buffer.data(), m_buffer.size())) {
+        qWarning("unable to write the snapshot of the generation %llu.",
+                 static_cast<unsigned long long>(generation));
+        detach();
+        return false;
+    }
+    m_index.push_back({generation, offset});
+    return true;
+}
+
+void SnapshotWriter::close()
+{
+    if (!m_file) {
+        return;
+    }
+    Snapshot::IndexFooter footer;
+    footer.numFrames = m_index.size();
+    footer.magic = Snapshot::IndexMagic;
+    if (!writeBytes(m_index.data(), m_index.size() * sizeof(Snapshot::IndexEntry))
+            || !writeBytes(&footer, sizeof(footer))) {
+        qWarning("unable to write the index of the snapshots; the reader will scan the frames.");
+    }
+    detach();
+}
+
+void SnapshotWriter::flush()
+{
+    if (m_file) {
+        m_file->flush();
+    }
+}
+
+void SnapshotWriter::detach()
+{
+    m_file.reset();
+    m_index.clear();
+}
+
+bool SnapshotWriter::writeBytes(const void* data, size_t size)
+{
+    const qint64 n = static_cast<qint64>(size);
+    if (m_file->write(static_cast<const char*>(data), n) != n) {
+        return false;
+    }
+    m_offset += size;
+    return true;
+}
+
+} // evoplex
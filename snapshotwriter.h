@@ -0,0 +1,72 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_SNAPSHOTWRITER_H
+#define FOLLOWFLEE_SNAPSHOTWRITER_H
+
+#include <memory>
+#include <vector>
+#include <QFile>
+#include <plugininterface.h>
+
+#include "snapshot.h"
+
+namespace evoplex {
+
+/**
+ * Appends the grid of each generation to a snapshot file (see Snapshot).
+ */
+class SnapshotWriter
+{
+public:
+    SnapshotWriter() = default;
+    ~SnapshotWriter() { close(); }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    /**
+     * @brief Creates the file at @p path for grids of @p numSlots slots;
+     * one frame in @p keyframeInterval is a keyframe.
+     * @returns false if the file could not be created
+     */
+    bool open(const QString& path, quint32 numSlots, quint32 width, quint32 keyframeInterval);
+
+    /**
+     * @brief Appends a frame with @p grid (strategy * 256 + actions, by node id).
+     * @returns false if the frame could not be written; the file is closed then
+     */
+    bool write(quint64 generation, const quint16* grid);
+
+    /**
+     * @brief Writes the index and closes the file.
+     */
+    void close();
+
+    /**
+     * @brief Writes the buffered frames to the file (eg, before fork()).
+     */
+    void flush();
+
+    /**
+     * @brief Closes the file without the index; for a forked process, whose
+     * parent keeps writing to the same file.
+     */
+    void detach();
+
+    bool isOpen() const { return m_file != nullptr; }
+
+private:
+    std::unique_ptr<QFile> m_file;
+    quint32 m_numSlots = 0;
+    quint32 m_keyframeInterval = 1;
+    quint64 m_offset = 0;              // the bytes written so far
+    std::vector<Snapshot::IndexEntry> m_index;
+    std::vector<quint64> m_planes;     // of the last frame
+    std::vector<quint64> m_previous;   // of the frame before it
+    std::vector<char> m_buffer;
+
+    bool writeBytes(const void* data, size_t size);
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_SNAPSHOTWRITER_H
@@ -0,0 +1,83 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_STREAMRNG_H
+#define FOLLOWFLEE_STREAMRNG_H
+
+#include <plugininterface.h>
+
+namespace evoplex {
+
+/**
+ * A tiny counter-based random number generator (splitmix64).
+ * It is cheap to create, so each logical event (eg, one agent-step) can have its
+ * own stream, keyed by the event itself instead of the order of the draws.
+ * It exposes the same uniform() calls used from the Evoplex PRG.
+ */
+class StreamRng
+{
+public:
+    explicit StreamRng(quint64 key) : m_state(key) {}
+
+    /**
+     * @brief Combines a few words in a single key.
+     */
+    static quint64 key(quint64 a, quint64 b, quint64 c = 0, quint64 d = 0) {
+        return mix(mix(mix(mix(a) ^ b) ^ c) ^ d);
+    }
+
+    /**
+     * @brief The splitmix64 finalizer.
+     */
+    static quint64 mix(quint64 z) {
+        z += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    quint64 next() {
+        m_state += 0x9E3779B97F4A7C15ULL;
+        quint64 z = m_state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /**
+     * @brief A uniformly distributed integer in [0, max].
+     */
+    template<typename T>
+    T uniform(T max) {
+        return static_cast<T>(bounded(static_cast<quint64>(max) + 1));
+    }
+
+    /**
+     * @brief A uniformly distributed integer in [min, max].
+     */
+    int uniform(int min, int max) {
+        return min + static_cast<int>(bounded(static_cast<quint64>(max - min) + 1));
+    }
+
+    /**
+     * @brief A uniformly distributed real number in [0, 1).
+     */
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    quint64 m_state;
+
+    // unbiased integer in [0, range) by rejection
+    quint64 bounded(quint64 range) {
+        const quint64 limit = ~quint64(0) - (~quint64(0) % range);
+        quint64 x;
+        do {
+            x = next();
+        } while (x >= limit);
+        return x % range;
+    }
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_STREAMRNG_H
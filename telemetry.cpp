@@ -0,0 +1,77 @@
+// Evoplex <https://evoplex.org>
+
+#include <chrono>
+#include <cstdio>
+
+#include "telemetry.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace evoplex {
+
+bool Telemetry::open(const QString& name)
+{
+    if (!m_segment.createNamed(name, sizeof(Record))) {
+        return false;
+    }
+
+    // the readers wait for the magic, which is written last
+    Record* r = record();
+    r->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    r->version = Version;
+#ifdef __linux__
+    r->pid = static_cast<qint64>(getpid());
+#else
+    r->pid = 0;
+#endif
+    r->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    r->magic = Magic;
+    m_lastNsecs = -1;
+    return true;
+}
+
+void Telemetry::publish(const Record& sample)
+{
+    using namespace std::chrono;
+    const qint64 now = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    const double interval = m_lastNsecs < 0 ? 0.0 : (now - m_lastNsecs) * 1e-9;
+    m_lastNsecs = now;
+
+    Record* r = record();
+    r->sequence.store(r->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // odd before the fields
+    r->generation = sample.generation;
+    r->agentSteps = sample.agentSteps;
+    r->agentStepsPerSecond = sample.agentStepsPerSecond;
+    r->stepSeconds = sample.stepSeconds;
+    r->replacementSeconds = sample.replacementSeconds;
+    r->intervalSeconds = interval;
+    r->agents = sample.agents;
+    r->emptyCells = sample.emptyCells;
+    r->rssBytes = residentBytes();
+    r->timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    r->sequence.store(r->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+quint64 Telemetry::residentBytes()
+{
+#ifdef __linux__
+    // the second field of statm is the resident set, in pages
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    unsigned long long size = 0, resident = 0;
+    const bool ok = std::fscanf(f, "%llu %llu", &size, &resident) == 2;
+    std::fclose(f);
+    return ok ? resident * static_cast<quint64>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+    return 0;
+#endif
+}
+
+} // evoplex
@@ -0,0 +1,78 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_TELEMETRY_H
+#define FOLLOWFLEE_TELEMETRY_H
+
+#include <atomic>
+#include <plugininterface.h>
+
+#include "sharedmemory.h"
+
+namespace evoplex {
+
+/**
+ * A small record in a named shared memory segment, updated at the end of
+ * each generation, so a running simulation can be monitored from outside
+ * (eg, with the followflee-telemetry collector).
+ *
+ * The record is guarded by a sequence, which is odd while it is written;
+ * so, a reader takes a consistent copy with:
+ *
+ *     do { s = record->sequence; copy the record; } while (s is odd || record->sequence != s);
+ */
+class Telemetry
+{
+public:
+    static const quint32 Magic = 0x54454646; // "FFET"
+    static const quint32 Version = 1;
+
+    struct Record {
+        quint32 magic;
+        quint32 version;
+        qint64 pid;
+        std::atomic<quint64> sequence;
+        quint64 generation;
+        quint64 agentSteps;          // the agent-steps of the last generation
+        double agentStepsPerSecond;  // the same, over the time of the steps phase
+        double stepSeconds;          // the steps phase of the last generation
+        double replacementSeconds;   // the replacement phase of the last generation
+        double intervalSeconds;      // the wall time since the previous record
+        quint64 agents;              // over all replicas of a batch
+        quint64 emptyCells;          // over all replicas of a batch
+        quint64 rssBytes;            // the resident memory of the process (Linux only)
+        qint64 timestamp;            // milliseconds since the epoch
+    };
+
+    /**
+     * @brief Creates (or reuses) the segment @p name.
+     * @returns false if the segment could not be created
+     */
+    bool open(const QString& name);
+
+    /**
+     * @brief Unmaps the segment.
+     */
+    void close() { m_segment.release(); }
+
+    bool isOpen() const { return m_segment.data() != nullptr; }
+
+    /**
+     * @brief Writes a new record; the fields of @p sample other than the
+     * header, the interval, the RSS and the timestamp are copied as they are.
+     */
+    void publish(const Record& sample);
+
+    /**
+     * @brief The resident memory of this process, or 0 if unknown.
+     */
+    static quint64 residentBytes();
+
+private:
+    SharedMemory m_segment;
+    qint64 m_lastNsecs = -1; // the monotonic clock at the previous record
+
+    Record* record() const { return static_cast<Record*>(m_segment.data()); }
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_TELEMETRY_H
@@ -0,0 +1,74 @@
+// Evoplex <https://evoplex.org>
+
+// Lists the frames of a snapshot file (the 'snapshotOutput' attribute) or
+// extracts the grid of a generation as a 16-bit PGM, which can be used as
+// the 'populationFile' of a new run.
+//
+// usage: followflee-snapshot <file>
+//        followflee-snapshot <file> <generation> <output.pgm>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "snapshotreader.h"
+
+using evoplex::SnapshotReader;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 4) {
+        std::fprintf(stderr, "usage: %s <file> [<generation> <output.pgm>]\n", argv[0]);
+        return 2;
+    }
+
+    SnapshotReader reader;
+    if (!reader.open(argv[1])) {
+        std::fprintf(stderr, "'%s' is not a snapshot file.\n", argv[1]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        std::printf("%u slots, width %u, %llu frames\n", reader.numSlots(), reader.width(),
+                    static_cast<unsigned long long>(reader.numFrames()));
+        std::vector<quint16> grid;
+        for (size_t f = 0; f < reader.numFrames(); ++f) {
+            if (!reader.read(f, grid)) {
+                std::fprintf(stderr, "the frame %llu is corrupted.\n", static_cast<unsigned long long>(f));
+                return 1;
+            }
+            size_t agents = 0, cooperators = 0;
+            for (quint16 v : grid) {
+                agents += (v >> 8) != 0;
+                cooperators += (v >> 8) == 1;
+            }
+            std::printf("%10llu %10llu %10llu\n", static_cast<unsigned long long>(reader.generation(f)),
+                        static_cast<unsigned long long>(agents),
+                        static_cast<unsigned long long>(cooperators));
+        }
+        return 0;
+    }
+
+    const int frame = reader.find(std::strtoull(argv[2], nullptr, 10));
+    std::vector<quint16> grid;
+    if (frame < 0 || !reader.read(static_cast<size_t>(frame), grid)) {
+        std::fprintf(stderr, "the generation %s is not in '%s'.\n", argv[2], argv[1]);
+        return 1;
+    }
+
+    const quint32 width = reader.width() > 0 ? reader.width() : reader.numSlots();
+    const quint32 height = (reader.numSlots() + width - 1) / width;
+    FILE* out = std::fopen(argv[3], "wb");
+    if (!out) {
+        std::fprintf(stderr, "unable to write '%s'.\n", argv[3]);
+        return 1;
+    }
+    std::fprintf(out, "P5\n%u %u\n%u\n", width, height, 0x2FF);
+    std::vector<unsigned char> pixels(2 * static_cast<size_t>(width) * height, 0);
+    for (size_t id = 0; id < grid.size(); ++id) {
+        pixels[2 * id] = static_cast<unsigned char>(grid[id] >> 8);
+        pixels[2 * id + 1] = static_cast<unsigned char>(grid[id] & 0xFF);
+    }
+    const bool ok = std::fwrite(pixels.data(), 1, pixels.size(), out) == pixels.size();
+    return std::fclose(out) == 0 && ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// Evoplex <https://evoplex.org>
+
+// A local collector for the telemetry segment of a running simulation
+// (the 'telemetry' attribute); it prints one line per new generation.
+//
+// usage: followflee-telemetry <name> [interval (ms)] [--once]
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+using evoplex::Telemetry;
+
+namespace {
+
+// a plain copy of the record (without the atomic sequence)
+struct Sample {
+    qint64 pid;
+    quint64 generation;
+    quint64 agentSteps;
+    double agentStepsPerSecond;
+    double stepSeconds;
+    double replacementSeconds;
+    double intervalSeconds;
+    quint64 agents;
+    quint64 emptyCells;
+    quint64 rssBytes;
+    qint64 timestamp;
+};
+
+bool readSample(const Telemetry::Record* r, Sample& s)
+{
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        const quint64 seq = r->sequence.load(std::memory_order_acquire);
+        if (seq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        s.pid = r->pid;
+        s.generation = r->generation;
+        s.agentSteps = r->agentSteps;
+        s.agentStepsPerSecond = r->agentStepsPerSecond;
+        s.stepSeconds = r->stepSeconds;
+        s.replacementSeconds = r->replacementSeconds;
+        s.intervalSeconds = r->intervalSeconds;
+        s.agents = r->agents;
+        s.emptyCells = r->emptyCells;
+        s.rssBytes = r->rssBytes;
+        s.timestamp = r->timestamp;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (r->sequence.load(std::memory_order_relaxed) == seq) {
+            return seq > 0; // 0: nothing published yet
+        }
+    }
+    return false;
+}
+
+qint64 nowMsecs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+void printSample(const Sample& s)
+{
+    std::printf("%10llu %14.0f %10.3f %10.3f %10.3f %10llu %10llu %10.1f %8.1f\n",
+                static_cast<unsigned long long>(s.generation), s.agentStepsPerSecond,
+                s.stepSeconds * 1e3, s.replacementSeconds * 1e3, s.intervalSeconds * 1e3,
+                static_cast<unsigned long long>(s.agents),
+                static_cast<unsigned long long>(s.emptyCells),
+                s.rssBytes / (1024.0 * 1024.0), (nowMsecs() - s.timestamp) * 1e-3);
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const char* name = nullptr;
+    int intervalMs = 500;
+    bool once = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--once") == 0) {
+            once = true;
+        } else if (!name) {
+            name = argv[i];
+        } else {
+            intervalMs = std::max(1, std::atoi(argv[i]));
+        }
+    }
+    if (!name) {
+        std::fprintf(stderr, "usage: %s <name> [interval (ms)] [--once]\n", argv[0]);
+        return 2;
+    }
+
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        std::fprintf(stderr, "unable to open '%s': %s\n", name, std::strerror(errno));
+        return 1;
+    }
+    void* data = mmap(nullptr, sizeof(Telemetry::Record), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        std::fprintf(stderr, "unable to map '%s': %s\n", name, std::strerror(errno));
+        return 1;
+    }
+    const auto* record = static_cast<const Telemetry::Record*>(data);
+
+    // the writer sets the magic last
+    while (record->magic != Telemetry::Magic) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (record->version != Telemetry::Version) {
+        std::fprintf(stderr, "'%s' has version %u; expected %u\n", name,
+                     record->version, Telemetry::Version);
+        return 1;
+    }
+
+    std::printf("%10s %14s %10s %10s %10s %10s %10s %10s %8s\n", "generation",
+                "agentSteps/s", "steps(ms)", "repl(ms)", "gen(ms)", "agents",
+                "emptyCells", "rss(MiB)", "age(s)");
+
+    Sample last;
+    bool hasLast = false;
+    while (true) {
+        Sample s;
+        if (readSample(record, s) && (!hasLast || s.generation != last.generation
+                                      || s.timestamp != last.timestamp)) {
+            printSample(s);
+            last = s;
+            hasLast = true;
+        }
+        if (once && hasLast) {
+            break;
+        }
+        // the simulation is gone; the segment may outlive it
+        const qint64 pid = record->pid;
+        if (pid > 0 && kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH) {
+            std::fprintf(stderr, "the process %lld has exited.\n", static_cast<long long>(pid));
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+
+    munmap(data, sizeof(Telemetry::Record));
+    return 0;
+}
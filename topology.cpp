@@ -0,0 +1,266 @@
+// Evoplex <https://evoplex.org>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <QSaveFile>
+
+#include "topology.h"
+
+namespace evoplex {
+
+// spreads the lower 16 bits of x over the even bits
+static quint32 spreadBits(quint32 x)
+{
+    x &= 0x0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+static quint64 mortonCode(int row, int column)
+{
+    const quint64 low = spreadBits(static_cast<quint32>(row)) << 1
+                      | spreadBits(static_cast<quint32>(column));
+    const quint64 high = spreadBits(static_cast<quint32>(row) >> 16) << 1
+                       | spreadBits(static_cast<quint32>(column) >> 16);
+    return high << 32 | low;
+}
+
+std::shared_ptr<const Topology> Topology::shared(const QString& key,
+        const std::function<void(Topology&)>& build)
+{
+    static std::mutex mutex;
+    static std::map<QString, std::weak_ptr<const Topology>> registry;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = registry.begin(); it != registry.end();) {
+            it = it->second.expired() ? registry.erase(it) : std::next(it);
+        }
+        // the last owner may release it at any time, without taking the lock
+        auto it = registry.find(key);
+        if (it != registry.end()) {
+            if (std::shared_ptr<const Topology> existing = it->second.lock()) {
+                return existing;
+            }
+        }
+    }
+
+    // built outside the lock, so the other experiments are not held back;
+    // if another one got there first, its copy is used instead
+    auto topology = std::make_shared<Topology>();
+    build(*topology);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::weak_ptr<const Topology>& entry = registry[key];
+    if (std::shared_ptr<const Topology> existing = entry.lock()) {
+        return existing;
+    }
+    entry = topology;
+    return topology;
+}
+
+size_t Topology::tablesSize(int numSlots, qint64 numEdges)
+{
+    // cells, node ids, out-offsets, out-ids, in-offsets and in-ids
+    return 4 * static_cast<size_t>(numSlots) + 2 + 2 * static_cast<size_t>(numEdges);
+}
+
+void Topology::assign(int* base, int numSlots, qint64 numEdges)
+{
+    m_size = numSlots;
+    m_numEdges = numEdges;
+    m_cells = base;
+    m_nodeIds = m_cells + numSlots;
+    m_outOffsets = m_nodeIds + numSlots;
+    m_outIds = m_outOffsets + numSlots + 1;
+    m_inOffsets = m_outIds + numEdges;
+    m_inIds = m_inOffsets + numSlots + 1;
+}
+
+void Topology::build(const Nodes& nodes, Layout layout, int width)
+{
+    int maxId = -1;
+    qint64 numEdges = 0;
+    for (Node node : nodes) {
+        maxId = std::max(maxId, node.id());
+        numEdges += static_cast<qint64>(node.outEdges().size());
+    }
+    const int numSlots = maxId + 1;
+
+    m_file.close();
+    m_storage.assign(tablesSize(numSlots, numEdges), 0);
+    assign(m_storage.data(), numSlots, numEdges);
+
+    // the order of the cells
+    std::iota(m_nodeIds, m_nodeIds + numSlots, 0);
+    if (layout == ZOrder && width > 0) {
+        std::vector<quint64> codes(static_cast<size_t>(numSlots));
+        for (int id = 0; id < numSlots; ++id) {
+            codes[id] = mortonCode(id / width, id % width);
+        }
+        std::stable_sort(m_nodeIds, m_nodeIds + numSlots,
+            [&codes](int a, int b) { return codes[a] < codes[b]; });
+    }
+    for (int c = 0; c < numSlots; ++c) {
+        m_cells[m_nodeIds[c]] = c;
+    }
+
+    // the RCM order needs the adjacency; so, build it by node ids first
+    if (layout == Rcm) {
+        fill(nodes);
+        const std::vector<int> order = reverseCuthillMcKee();
+        std::copy(order.begin(), order.end(), m_nodeIds);
+        for (int c = 0; c < numSlots; ++c) {
+            m_cells[m_nodeIds[c]] = c;
+        }
+    }
+
+    fill(nodes);
+}
+
+void Topology::fill(const Nodes& nodes)
+{
+    const size_t numSlots = static_cast<size_t>(m_size);
+
+    // out-neighbours, in the same order as Node::outEdges()
+    std::vector<int> outDegrees(numSlots, 0);
+    std::vector<int> inDegrees(numSlots, 0);
+    for (Node node : nodes) {
+        for (Node neighbour : node.outEdges()) {
+            ++outDegrees[m_cells[node.id()]];
+            ++inDegrees[m_cells[neighbour.id()]];
+        }
+    }
+
+    m_outOffsets[0] = 0;
+    m_inOffsets[0] = 0;
+    for (size_t c = 0; c < numSlots; ++c) {
+        m_outOffsets[c+1] = m_outOffsets[c] + outDegrees[c];
+        m_inOffsets[c+1] = m_inOffsets[c] + inDegrees[c];
+    }
+
+    std::vector<int> outPos(m_outOffsets, m_outOffsets + numSlots);
+    std::vector<int> inPos(m_inOffsets, m_inOffsets + numSlots);
+    for (Node node : nodes) {
+        const int cell = m_cells[node.id()];
+        for (Node neighbour : node.outEdges()) {
+            const int neighbourCell = m_cells[neighbour.id()];
+            m_outIds[outPos[cell]++] = neighbourCell;
+            m_inIds[inPos[neighbourCell]++] = cell;
+        }
+    }
+}
+
+bool Topology::load(const QString& path, quint64 sourceHash, quint64 graphHash, Layout layout, int width)
+{
+    m_file.close();
+    m_storage.clear();
+    m_storage.shrink_to_fit();
+    assign(nullptr, 0, 0);
+
+    if (!m_file.open(path) || m_file.size() < sizeof(CacheHeader)) {
+        m_file.close();
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (header.magic != CacheMagic || header.version != CacheVersion
+            || header.layout != static_cast<quint32>(layout) || header.width != width
+            || header.sourceHash != sourceHash || header.graphHash != graphHash
+            || header.numSlots < 0 || header.numEdges < 0
+            || m_file.size() != sizeof(header)
+                + tablesSize(header.numSlots, header.numEdges) * sizeof(int)) {
+        m_file.close();
+        return false;
+    }
+
+    // the mapping is page-aligned and the header keeps the tables aligned
+    int* base = reinterpret_cast<int*>(const_cast<char*>(m_file.data() + sizeof(header)));
+    assign(base, header.numSlots, header.numEdges);
+    return true;
+}
+
+bool Topology::save(const QString& path, quint64 sourceHash, quint64 graphHash, Layout layout, int width) const
+{
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = CacheMagic;
+    header.version = CacheVersion;
+    header.layout = static_cast<quint32>(layout);
+    header.width = width;
+    header.numSlots = m_size;
+    header.numEdges = m_numEdges;
+    header.sourceHash = sourceHash;
+    header.graphHash = graphHash;
+
+    // written to a temporary file and renamed, so readers never see a partial cache
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const qint64 tablesBytes = static_cast<qint64>(tablesSize(m_size, m_numEdges) * sizeof(int));
+    if (file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header)
+            || file.write(reinterpret_cast<const char*>(m_cells), tablesBytes) != tablesBytes) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+std::vector<int> Topology::reverseCuthillMcKee() const
+{
+    const int numCells = size();
+    auto degree = [this](int c) {
+        return static_cast<int>(outNeighbours(c).size() + inNeighbours(c).size());
+    };
+
+    // the cells sorted by degree; each connected component starts from
+    // its unvisited cell of lowest degree
+    std::vector<int> byDegree(static_cast<size_t>(numCells));
+    std::iota(byDegree.begin(), byDegree.end(), 0);
+    std::stable_sort(byDegree.begin(), byDegree.end(),
+        [&degree](int a, int b) { return degree(a) < degree(b); });
+
+    // breadth-first search (the edges are taken as undirected),
+    // visiting the neighbours of each cell by increasing degree
+    std::vector<int> order;
+    order.reserve(static_cast<size_t>(numCells));
+    std::vector<bool> visited(static_cast<size_t>(numCells), false);
+    std::vector<int> neighbours;
+    for (int start : byDegree) {
+        if (visited[start]) {
+            continue;
+        }
+        visited[start] = true;
+        order.emplace_back(start);
+        for (size_t head = order.size() - 1; head < order.size(); ++head) {
+            const int c = order[head];
+            neighbours.clear();
+            for (int nc : outNeighbours(c)) {
+                if (!visited[nc]) { visited[nc] = true; neighbours.emplace_back(nc); }
+            }
+            for (int nc : inNeighbours(c)) {
+                if (!visited[nc]) { visited[nc] = true; neighbours.emplace_back(nc); }
+            }
+            std::stable_sort(neighbours.begin(), neighbours.end(),
+                [&degree](int a, int b) { return degree(a) < degree(b); });
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+
+    // from cells (ie, the node ids of the current order) to node ids
+    std::reverse(order.begin(), order.end());
+    for (int& c : order) {
+        c = m_nodeIds[c];
+    }
+    return order;
+}
+
+} // evoplex
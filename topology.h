@@ -0,0 +1,164 @@
+// Evoplex <https://evoplex.org>
+
+#ifndef FOLLOWFLEE_TOPOLOGY_H
+#define FOLLOWFLEE_TOPOLOGY_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <plugininterface.h>
+
+#include "mappedfile.h"
+
+namespace evoplex {
+
+/**
+ * A compact, read-only copy of the graph's adjacency in the CSR format.
+ * It keeps both the out- and the in-neighbours of each node, so the model can
+ * update per-cell tables without going through the Evoplex graph.
+ *
+ * The adjacency is indexed by cells, which are the node ids laid out in an
+ * order that keeps the neighbours close in memory; cell() and nodeId() map
+ * between both at the boundary with Evoplex.
+ *
+ * The tables can be saved to a binary cache and mapped back (read-only)
+ * by later runs, instead of being built again.
+ */
+class Topology
+{
+public:
+    /**
+     * The order of the cells.
+     */
+    enum Layout {
+        NodeIds,  // same as the node ids
+        ZOrder,   // Morton order of the (row, column) of a grid; needs its width
+        Rcm       // reverse Cuthill-McKee order; for graphs of any shape (eg, from files)
+    };
+    /**
+     * A convenient range over the neighbour ids of a node.
+     */
+    struct Ids {
+        const int* first;
+        const int* last;
+
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+    };
+
+    Topology() = default;
+    Topology(const Topology&) = delete;
+    Topology& operator=(const Topology&) = delete;
+
+    /**
+     * @brief The topology registered under @p key by an experiment of this
+     * process, or a new one filled by @p build and registered.
+     * The registry only keeps weak references; so, a topology lives as long
+     * as an experiment uses it. It is safe to call from several threads.
+     */
+    static std::shared_ptr<const Topology> shared(const QString& key,
+            const std::function<void(Topology&)>& build);
+
+    /**
+     * @brief Builds the adjacency lists from the Evoplex @p nodes.
+     * @param width the number of columns of the grid (ZOrder only)
+     */
+    void build(const Nodes& nodes, Layout layout = NodeIds, int width = 0);
+
+    /**
+     * @brief Maps the tables saved at @p path.
+     * The cache is only used if it was built with the same layout and width
+     * from a source whose content hash is @p sourceHash, read with graph
+     * attributes (eg, directed) whose hash is @p graphHash.
+     * @returns false if the cache is missing, stale or invalid
+     */
+    bool load(const QString& path, quint64 sourceHash, quint64 graphHash, Layout layout, int width);
+
+    /**
+     * @brief Writes the tables to @p path (atomically; concurrent runs are safe).
+     * @returns false if the file could not be written
+     */
+    bool save(const QString& path, quint64 sourceHash, quint64 graphHash, Layout layout, int width) const;
+
+    /**
+     * @brief The number of slots, ie, the highest node id plus one.
+     */
+    int size() const { return m_size; }
+
+    /**
+     * @brief The cell of the node @p nodeId.
+     */
+    int cell(int nodeId) const { return m_cells[nodeId]; }
+
+    /**
+     * @brief The node id of the cell @p cell.
+     */
+    int nodeId(int cell) const { return m_nodeIds[cell]; }
+
+    Ids outNeighbours(int id) const {
+        return {m_outIds + m_outOffsets[id], m_outIds + m_outOffsets[id+1]};
+    }
+
+    Ids inNeighbours(int id) const {
+        return {m_inIds + m_inOffsets[id], m_inIds + m_inOffsets[id+1]};
+    }
+
+private:
+    /**
+     * The header of the binary cache; it is followed by the tables,
+     * in the same order as in m_storage.
+     */
+    struct CacheHeader {
+        quint64 magic;
+        quint32 version;
+        quint32 layout;
+        qint32 width;
+        qint32 numSlots;
+        qint64 numEdges;
+        quint64 sourceHash;
+        quint64 graphHash;
+        quint64 reserved[2];
+    };
+    static const quint64 CacheMagic = 0x5253434545464646ULL; // "FFFEECSR"
+    static const quint32 CacheVersion = 2;
+
+    /**
+     * @brief Points the tables to @p base, which holds all of them in a row.
+     */
+    void assign(int* base, int numSlots, qint64 numEdges);
+
+    /**
+     * @brief The number of ints needed to hold all the tables.
+     */
+    static size_t tablesSize(int numSlots, qint64 numEdges);
+
+    /**
+     * @brief Fills the adjacency lists using the current order of the cells.
+     */
+    void fill(const Nodes& nodes);
+
+    /**
+     * @brief The reverse Cuthill-McKee order of the current adjacency.
+     * @returns the node id of each cell
+     */
+    std::vector<int> reverseCuthillMcKee() const;
+
+    int m_size = 0;
+    qint64 m_numEdges = 0;
+
+    // the tables; they point to m_storage or, when loaded, to the
+    // read-only mapping of the cache (which is never written)
+    int* m_cells = nullptr;   // by node id
+    int* m_nodeIds = nullptr; // by cell
+    int* m_outOffsets = nullptr;
+    int* m_outIds = nullptr;
+    int* m_inOffsets = nullptr;
+    int* m_inIds = nullptr;
+
+    std::vector<int> m_storage;
+    MappedFile m_file;
+};
+
+} // evoplex
+#endif // FOLLOWFLEE_TOPOLOGY_H